@@ -0,0 +1,815 @@
+/**
+* Benchmarks for the Trie and segmentation kernels of words.cpp
+*
+* with GNU g++
+* -------------
+* g++ -O2 -pthread -Wall -I. -o bench bench.cpp
+*
+* bench [-n N,N,...] [-L min-max] [-d uniform|short] [-c ratio] [-r reps]
+*       [-s seed] [-k kernel] [-f file]...
+* bench -A [-b steps] [-r reps] [-k kernel]
+* bench -S [-T N,N,...] [-n N,N,...] [-r reps] [other dictionary options]
+* -n: sizes of the synthetic dictionaries (default 10000,100000)
+* -L: word length range of the synthetic dictionaries (default 3-12)
+* -d: length distribution, uniform over the range or skewed to short words
+* -c: ratio of compound words made of 2-3 other words (default 0.3)
+* -r: repetitions of each kernel (default 5)
+* -s: random seed, the same seed gives the same dictionaries
+* -k: only run the kernels whose name contains this text
+* -f: also run on a word file (default wordsforproblem.txt when present)
+* -A: run the adversarial suite instead, worst cases of the segmentation
+* -b: step budget per word of the timed adversarial runs (default 1000000),
+*     the checks use their own ADVERSARIAL_STEPS
+* -S: run the concurrent insert stress test instead, on synthetic
+*     dictionaries and word files
+* -T: thread counts of the stress test (default 1,2,4,8)
+*/
+
+/**
+ * Every kernel runs over all words of a dictionary, r times. The report
+ * gives the mean time per word (ns/op), its standard deviation over the
+ * repetitions and the throughput, so layouts and algorithms can be
+ * compared on the same dictionaries:
+ *
+ *   kernel        layout        dict           ops     ns/op   stddev   Mops/s
+ *   concatWord    pointer       syn-100000  100000     182.3     2.1%     5.49
+ *
+ * The adversarial suite (-A) runs one pathological word per line, the
+ * dict column ends with "timed-out" when the word ran out of the budget,
+ * and fails the run when a check below does not hold.
+ */
+
+#define WORDS_NO_MAIN
+#include "words.cpp"
+
+#include <math.h>
+#include <stdlib.h>
+
+// a dictionary to run the kernels on
+typedef struct BenchDict {
+    string label;
+    string path;            // the same words, one per line, for ReadWordFile()
+    bool temporary;         // path was written by the benchmark
+    vector<char> text;      // file contents, split in place
+    vector<wordref> words;
+}benchDict;
+
+typedef struct BenchOptions {
+    vector<size_t> sizes;
+    int minLen;
+    int maxLen;
+    bool shortWords;        // skew the lengths to short words
+    double compound;
+    int reps;
+    uint64_t seed;
+    const char *kernel;     // NULL: all kernels
+    bool adversarial;
+    int64_t budget;
+    bool stress;
+    vector<size_t> threads; // thread counts of the stress test
+    vector<const char*> files;
+}benchOptions;
+
+// keeps the results alive so the kernels are not optimized away
+static volatile size_t benchSink;
+
+// xorshift64*, deterministic for a given seed
+static uint64_t benchRandom(uint64_t &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+static int benchLength(const benchOptions &opt, uint64_t &state)
+{
+    int span = opt.maxLen - opt.minLen + 1;
+    int len = opt.minLen + (int)(benchRandom(state) % span);
+    if (opt.shortWords) {
+        // minimum of two draws: short words are more likely
+        int other = opt.minLen + (int)(benchRandom(state) % span);
+        len = min(len, other);
+    }
+    return len;
+}
+
+// split the text of a dictionary into its words
+static void benchSplit(benchDict *dict)
+{
+    dict->text.push_back('\0');
+    dict->words.clear();
+    splitLines(&dict->text[0], dict->text.size() - 1, [&](const char *str, int len) {
+        wordref word = {str, len};
+        dict->words.push_back(word);
+    });
+}
+
+/**
+ * generate a synthetic dictionary of cnt words
+ * the compound ratio of words are made of 2-3 earlier words, so the
+ * segmentation kernels find work
+ */
+static void benchGenerate(benchDict *dict, size_t cnt, const benchOptions &opt, uint64_t &state)
+{
+    vector<size_t> start;
+    vector<int> length;
+    string body;
+    for (size_t i = 0; i < cnt; i++) {
+        bool compound = i > 16 && (double)(benchRandom(state) % 1000000) / 1000000 < opt.compound;
+        start.push_back(body.size());
+        if (compound) {
+            int parts = 2 + (int)(benchRandom(state) % 2);
+            size_t from = body.size();
+            for (int k = 0; k < parts; k++) {
+                size_t j = benchRandom(state) % i;
+                body.append(body, start[j], length[j]);
+            }
+            length.push_back((int)(body.size() - from));
+        } else {
+            int len = benchLength(opt, state);
+            for (int k = 0; k < len; k++)
+                body += (char)('a' + benchRandom(state) % CHAR_SIZE);
+            length.push_back(len);
+        }
+        body += '\n';
+    }
+    char label[64];
+    snprintf(label, sizeof(label), "syn-%zu", cnt);
+    dict->label = label;
+
+    // no file: the kernels that read one are skipped
+    dict->path.clear();
+    dict->temporary = false;
+    char path[] = "/tmp/bench_wordsXXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        ssize_t n = write(fd, body.data(), body.size());
+        (void)n;
+        close(fd);
+        dict->path = path;
+        dict->temporary = true;
+    }
+    dict->text.assign(body.begin(), body.end());
+    benchSplit(dict);
+}
+
+// load a word file as a dictionary
+static bool benchLoad(benchDict *dict, const char *filename)
+{
+    mappedFile file;
+    if (!mapFile(filename, &file))
+        return false;
+    dict->label = filename;
+    dict->path = filename;
+    dict->temporary = false;
+    dict->text.assign(file.data, file.data + file.size);
+    unmapFile(&file);
+    benchSplit(dict);
+    return true;
+}
+
+/**
+ * time fn() reps times, fn() handles ops words per call
+ * prints mean ns/op, relative standard deviation and throughput
+ */
+template <class F>
+void benchRun(const benchOptions &opt, const char *kernel, const char *layout, const benchDict &dict, size_t ops, F fn)
+{
+    if (opt.kernel != NULL && strstr(kernel, opt.kernel) == NULL)
+        return;
+    vector<double> nsPerOp;
+    // warm up once, untimed
+    fn();
+    for (int r = 0; r < opt.reps; r++) {
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        fn();
+        chrono::duration<double> wall = chrono::steady_clock::now() - t0;
+        nsPerOp.push_back(wall.count() * 1e9 / max(ops, (size_t)1));
+    }
+    double mean = 0, var = 0;
+    for (size_t i = 0; i < nsPerOp.size(); i++)
+        mean += nsPerOp[i];
+    mean /= nsPerOp.size();
+    for (size_t i = 0; i < nsPerOp.size(); i++)
+        var += (nsPerOp[i] - mean) * (nsPerOp[i] - mean);
+    var /= nsPerOp.size();
+    printf("%-24s %-13s %-30s %9zu %10.1f %7.1f%% %9.2f\n", kernel, layout, dict.label.c_str(),
+           ops, mean, mean > 0 ? 100.0 * sqrt(var) / mean : 0.0, mean > 0 ? 1e3 / mean : 0.0);
+    fflush(stdout);
+}
+
+// isLeafBreak() and concatWord() on one layout
+template <class T>
+void benchLookups(const benchOptions &opt, const char *layout, T *dict, const benchDict &d)
+{
+    const vector<wordref> &words = d.words;
+    benchRun(opt, "isLeafBreak", layout, d, words.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            int mid = 0;
+            sum += isLeafBreak(dict, words[i].str, 0, words[i].len - 1, mid);
+            sum += mid;
+        }
+        benchSink = sum;
+    });
+    benchRun(opt, "concatWord", layout, d, words.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            bool found;
+            sum += concatWord(dict, words[i].str, 0, words[i].len - 1, found);
+        }
+        benchSink = sum;
+    });
+    benchRun(opt, "wordPartsRange", layout, d, words.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            int minParts, maxParts;
+            wordPartsRange(dict, words[i].str, 0, words[i].len - 1, minParts, maxParts);
+            sum += minParts + maxParts;
+        }
+        benchSink = sum;
+    });
+    benchRun(opt, "wordSplitCount", layout, d, words.size(), [&]() {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < words.size(); i++)
+            sum += wordSplitCount(dict, words[i].str, 0, words[i].len - 1);
+        benchSink = sum;
+    });
+}
+
+// all kernels on one dictionary
+static void benchDictionary(const benchOptions &opt, const benchDict &d)
+{
+    const vector<wordref> &words = d.words;
+
+    // insertWord() into every insertable layout
+    benchRun(opt, "insertWord", layoutName[LAYOUT_POINTER], d, words.size(), [&]() {
+        arena pool;
+        arenaInit(&pool);
+        trie *root = create(&pool);
+        for (size_t i = 0; i < words.size(); i++)
+            insertWord(root, words[i].str, &pool);
+        benchSink = pool.nodes;
+        trieDestroy(root, &pool);
+    });
+    benchRun(opt, "insertWord", layoutName[LAYOUT_COMPACT], d, words.size(), [&]() {
+        ctrie t;
+        create(&t);
+        for (size_t i = 0; i < words.size(); i++)
+            insertWord(&t, words[i].str);
+        benchSink = t.node.size();
+    });
+    benchRun(opt, "insertWord", layoutName[LAYOUT_BITMAP], d, words.size(), [&]() {
+        btrie t;
+        create(&t);
+        for (size_t i = 0; i < words.size(); i++)
+            insertWord(&t, words[i].str);
+        benchSink = t.node.size();
+    });
+
+    // ReadWordFile(): map, split, insert and bucket
+    if (!d.path.empty()) {
+        benchRun(opt, "ReadWordFile", layoutName[LAYOUT_POINTER], d, words.size(), [&]() {
+            trie *root;
+            arena pool;
+            arenaInit(&pool);
+            wordStore store;
+            storeInit(&store);
+            mappedFile input;
+            benchSink = ReadWordFile(d.path.c_str(), &input, root, &pool, &store);
+            trieDestroy(root, &pool);
+            unmapFile(&input);
+        });
+    }
+
+    // lookups on every layout
+    arena pool;
+    arenaInit(&pool);
+    trie *root = create(&pool);
+    wordStore store;
+    storeInit(&store);
+    for (size_t i = 0; i < words.size(); i++) {
+        insertWord(root, words[i].str, &pool);
+        storeAdd(&store, words[i].str, words[i].len);
+    }
+    vector<const char*> sorted;
+    sortedWords(&store, sorted);
+
+    // the longest first order of the search
+    benchRun(opt, "storeSortByLength", "", d, words.size(), [&]() {
+        wordStore copy = store;
+        storeSortByLength(&copy);
+        benchSink = copy.word[0].len;
+    });
+
+    benchLookups(opt, layoutName[LAYOUT_POINTER], root, d);
+    benchRun(opt, "concatWordRecursive", layoutName[LAYOUT_POINTER], d, words.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            bool found;
+            sum += concatWordRecursive(root, words[i].str, 0, words[i].len - 1, found);
+        }
+        benchSink = sum;
+    });
+    // one Aho-Corasick pass per word, and over all words as one text
+    acBuild(root);
+    benchRun(opt, "acConcatWord", layoutName[LAYOUT_POINTER], d, words.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            bool found;
+            sum += acConcatWord(root, words[i].str, 0, words[i].len - 1, found);
+        }
+        benchSink = sum;
+    });
+    benchRun(opt, "acScan", layoutName[LAYOUT_POINTER], d, words.size(), [&]() {
+        // the split text, the '\0' between the words ends every match
+        benchSink = acScan(root, &d.text[0], d.text.size() - 1, [](size_t end, int len) {});
+    });
+    {
+        ctrie t;
+        create(&t, root);
+        benchLookups(opt, layoutName[LAYOUT_COMPACT], &t, d);
+    }
+    {
+        btrie t;
+        create(&t, root);
+        benchLookups(opt, layoutName[LAYOUT_BITMAP], &t, d);
+    }
+    {
+        datrie t;
+        create(&t, sorted);
+        benchLookups(opt, layoutName[LAYOUT_DOUBLE_ARRAY], &t, d);
+    }
+    {
+        btrie t;
+        createDawg(&t, sorted);
+        benchLookups(opt, layoutName[LAYOUT_DAWG], &t, d);
+    }
+
+    // end to end: load, search and write, as the output program does
+    if (!d.path.empty()) {
+        benchRun(opt, "end-to-end", layoutName[LAYOUT_POINTER], d, words.size(), [&]() {
+            trie *e2eRoot;
+            arena e2ePool;
+            arenaInit(&e2ePool);
+            wordStore e2eStore;
+            storeInit(&e2eStore);
+            mappedFile input;
+            phaseTimer timer;
+            timerInit(&timer);
+            ReadWordFile(d.path.c_str(), &input, e2eRoot, &e2ePool, &e2eStore);
+            outBuffer out;
+            outOpen(&out, "/dev/null", NULL);
+            // the search prints the longest words, keep the report clean
+            cout.setstate(ios::failbit);
+            benchSink = searchCompounds(e2eRoot, (int)SEARCH_FIRST, (int)SEGMENT_DP, (suffixCache *)NULL, 1, 0, 0, false, &e2eStore, &out, &timer);
+            cout.clear();
+            outClose(&out);
+            trieDestroy(e2eRoot, &e2ePool);
+            unmapFile(&input);
+        });
+    }
+    trieDestroy(root, &pool);
+}
+
+/**
+ * Adversarial suite
+ * Pathological dictionaries and queries for the segmentation: every
+ * prefix is a word but the query never splits, so the recursion tries
+ * exponentially many splits and the dynamic programming does O(L^2)
+ * steps; and very long words that split into thousands of subwords,
+ * nesting the search deeply. Run as a regression suite, each query is
+ * checked: concatWord() must return its expected count within
+ * (L + 1) * (W + 1) Trie steps, W the longest dictionary word, so it
+ * stays polynomial (and, being iterative, within the stack); and with
+ * ADVERSARIAL_STEPS the recursion must finish or time out as expected.
+ */
+
+#define ADVERSARIAL_STEPS   1000000
+
+typedef struct AdversarialCase {
+    const char *name;
+    vector<string> dict;
+    vector<string> query;
+    vector<string> pattern;     // what each query is, "a^24b", for the reports
+    vector<int> parts;          // expected concatWord() count of each query
+    vector<bool> timesOut;      // whether the recursion runs out of ADVERSARIAL_STEPS
+}adversarialCase;
+
+static string benchRepeat(const string &unit, size_t cnt)
+{
+    string text;
+    for (size_t i = 0; i < cnt; i++)
+        text += unit;
+    return text;
+}
+
+// "unit^cnt" then tail, the pattern of a query
+static string benchPattern(const char *unit, size_t cnt, const char *tail = "")
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), strlen(unit) > 1 ? "(%s)^%zu%s" : "%s^%zu%s", unit, cnt, tail);
+    return pattern;
+}
+
+static void benchAdversarialCases(vector<adversarialCase> &cases)
+{
+    // {a, aa, ..., a^20} against a^n b
+    adversarialCase unary;
+    unary.name = "unary-prefixes";
+    for (int k = 1; k <= 20; k++)
+        unary.dict.push_back(string(k, 'a'));
+    for (size_t n : {24, 64, 256, 4096}) {
+        unary.query.push_back(string(n, 'a') + 'b');
+        unary.pattern.push_back(benchPattern("a", n, "b"));
+        unary.parts.push_back(0);
+        unary.timesOut.push_back(true);
+    }
+    cases.push_back(unary);
+
+    // every word over {a, b} up to length 4 against (ab)^n c
+    adversarialCase binary;
+    binary.name = "binary-all";
+    for (int len = 1; len <= 4; len++) {
+        for (int bits = 0; bits < (1 << len); bits++) {
+            string word;
+            for (int k = 0; k < len; k++)
+                word += (bits >> k) & 1 ? 'b' : 'a';
+            binary.dict.push_back(word);
+        }
+    }
+    for (size_t n : {16, 64, 1024}) {
+        binary.query.push_back(benchRepeat("ab", n) + 'c');
+        binary.pattern.push_back(benchPattern("ab", n, "c"));
+        binary.parts.push_back(0);
+        binary.timesOut.push_back(true);
+    }
+    cases.push_back(binary);
+
+    // {a} against a^n: n subwords, as deep as the word is long
+    adversarialCase deep;
+    deep.name = "deep-split";
+    deep.dict.push_back("a");
+    deep.dict.push_back("ab");
+    for (size_t n : {1000, 100000, 1000000}) {
+        deep.query.push_back(string(n, 'a'));
+        deep.pattern.push_back(benchPattern("a", n));
+        deep.parts.push_back((int)n);
+        // each call is charged its suffix: n^2 / 2 steps
+        deep.timesOut.push_back(n * n / 2 > ADVERSARIAL_STEPS);
+    }
+    deep.query.push_back(benchRepeat("ab", 500000));
+    deep.pattern.push_back(benchPattern("ab", 500000));
+    deep.parts.push_back(500000);
+    deep.timesOut.push_back(true);
+    cases.push_back(deep);
+}
+
+// check one query of a case, print what does not hold
+static bool benchAdversarialCheck(const adversarialCase &ac, size_t q, trie *root, size_t longest)
+{
+    const string &query = ac.query[q];
+    bool ok = true;
+    int64_t bound = (int64_t)(query.size() + 1) * (longest + 1);
+    int64_t steps = bound;
+    bool found;
+    int cnt = concatWord(root, query.c_str(), 0, (int)query.size() - 1, found, (suffixCache *)NULL, &steps);
+    if (cnt == CONCAT_TIMED_OUT) {
+        printf("%s-%s: concatWord took more than %lld steps\n", ac.name, ac.pattern[q].c_str(), (long long)bound);
+        ok = false;
+    } else if ((found ? cnt : 0) != ac.parts[q]) {
+        printf("%s-%s: concatWord found %d subwords, expected %d\n", ac.name, ac.pattern[q].c_str(), found ? cnt : 0, ac.parts[q]);
+        ok = false;
+    }
+    steps = ADVERSARIAL_STEPS;
+    bool timedOut = concatWordRecursive(root, query.c_str(), 0, (int)query.size() - 1, found, &steps) == CONCAT_TIMED_OUT;
+    if (timedOut != ac.timesOut[q]) {
+        printf("%s-%s: the recursion %s %d steps, expected it to %s\n", ac.name, ac.pattern[q].c_str(),
+               timedOut ? "ran out of" : "finished within", ADVERSARIAL_STEPS, ac.timesOut[q] ? "time out" : "finish");
+        ok = false;
+    }
+    return ok;
+}
+
+// returns false when a check fails
+static bool benchAdversarial(const benchOptions &opt)
+{
+    vector<adversarialCase> cases;
+    benchAdversarialCases(cases);
+    bool ok = true;
+    for (size_t c = 0; c < cases.size(); c++) {
+        const adversarialCase &ac = cases[c];
+        arena pool;
+        arenaInit(&pool);
+        trie *root = create(&pool);
+        size_t longest = 0;
+        for (size_t i = 0; i < ac.dict.size(); i++) {
+            insertWord(root, ac.dict[i].c_str(), &pool);
+            longest = max(longest, ac.dict[i].size());
+        }
+
+        // one query at a time, so the report shows each length
+        for (size_t q = 0; q < ac.query.size(); q++) {
+            const string &query = ac.query[q];
+            ok = benchAdversarialCheck(ac, q, root, longest) && ok;
+            benchDict d;
+            d.label = string(ac.name) + "-" + ac.pattern[q];
+            d.temporary = false;
+            wordref word = {query.c_str(), (int)query.size()};
+            d.words.push_back(word);
+
+            benchRun(opt, "concatWord", layoutName[LAYOUT_POINTER], d, 1, [&]() {
+                bool found;
+                benchSink = concatWord(root, word.str, 0, word.len - 1, found);
+            });
+
+            // with the budget, the label tells whether the word ran out of it
+            benchDict budgeted = d;
+            int64_t steps = opt.budget;
+            bool found;
+            if (concatWord(root, word.str, 0, word.len - 1, found, (suffixCache *)NULL, &steps) == CONCAT_TIMED_OUT)
+                budgeted.label += " timed-out";
+            benchRun(opt, "concatWord -b", layoutName[LAYOUT_POINTER], budgeted, 1, [&]() {
+                int64_t steps = opt.budget;
+                bool found;
+                benchSink = concatWord(root, word.str, 0, word.len - 1, found, (suffixCache *)NULL, &steps);
+            });
+
+            // never without a budget: exponential or too deep
+            budgeted = d;
+            steps = opt.budget;
+            if (concatWordRecursive(root, word.str, 0, word.len - 1, found, &steps) == CONCAT_TIMED_OUT)
+                budgeted.label += " timed-out";
+            benchRun(opt, "concatWordRecursive -b", layoutName[LAYOUT_POINTER], budgeted, 1, [&]() {
+                int64_t steps = opt.budget;
+                bool found;
+                benchSink = concatWordRecursive(root, word.str, 0, word.len - 1, found, &steps);
+            });
+        }
+        trieDestroy(root, &pool);
+    }
+    return ok;
+}
+
+/**
+ * Concurrent insert stress test
+ * T threads insert the words of a dictionary into one shared Trie at the
+ * same time, thread t taking every T-th word so neighbours in the file,
+ * which share prefixes, race for the same slots. insertWordConcurrent()
+ * is compared with insertWord() under one global mutex, then the shared
+ * Trie is checked against the serial one: same node count, same leaf
+ * count, every word found.
+ */
+typedef struct StressWorker {
+    const vector<wordref> *words;
+    trie *root;
+    arena pool;             // nodes of this thread
+    pthread_mutex_t *lock;  // NULL: lock free
+    size_t index;
+    size_t stride;
+}stressWorker;
+
+static void* stressThread(void *arg)
+{
+    stressWorker *worker = (stressWorker *)arg;
+    const vector<wordref> &words = *worker->words;
+    for (size_t i = worker->index; i < words.size(); i += worker->stride) {
+        if (worker->lock == NULL) {
+            insertWordConcurrent(worker->root, words[i].str, &worker->pool);
+        } else {
+            pthread_mutex_lock(worker->lock);
+            insertWord(worker->root, words[i].str, &worker->pool);
+            pthread_mutex_unlock(worker->lock);
+        }
+    }
+    return NULL;
+}
+
+// insert words on threads into root, the nodes end up in pool
+static void stressInsert(trie *root, arena *pool, const vector<wordref> &words, size_t threads, pthread_mutex_t *lock)
+{
+    vector<stressWorker> worker(threads);
+    vector<pthread_t> tid(threads);
+    for (size_t t = 0; t < threads; t++) {
+        worker[t].words = &words;
+        worker[t].root = root;
+        arenaInit(&worker[t].pool);
+        worker[t].lock = lock;
+        worker[t].index = t;
+        worker[t].stride = threads;
+        pthread_create(&tid[t], NULL, stressThread, &worker[t]);
+    }
+    for (size_t t = 0; t < threads; t++) {
+        pthread_join(tid[t], NULL);
+        arenaMerge(pool, &worker[t].pool);
+    }
+}
+
+static size_t stressLeaves(const trie *node)
+{
+    size_t cnt = node->isLeaf;
+    for (int i = 0; i < CHAR_SIZE; i++) {
+        if (node->character[i] != NULL)
+            cnt += stressLeaves(node->character[i]);
+    }
+    return cnt;
+}
+
+// true when root holds exactly the words of the serial Trie
+static bool stressCheck(trie *root, const arena &pool, const arena &serialPool, size_t serialLeaves, const vector<wordref> &words)
+{
+    if (pool.nodes != serialPool.nodes || stressLeaves(root) != serialLeaves)
+        return false;
+    for (size_t i = 0; i < words.size(); i++) {
+        const trie *cur = trieRoot(root);
+        for (int k = 0; k < words[i].len && cur != NULL; k++)
+            cur = trieNext(root, cur, words[i].str[k] - 'a');
+        if (cur == NULL || !trieIsLeaf(root, cur))
+            return false;
+    }
+    return true;
+}
+
+static bool benchStress(const benchOptions &opt, const benchDict &d)
+{
+    const vector<wordref> &words = d.words;
+    arena serialPool;
+    arenaInit(&serialPool);
+    trie *serialRoot = create(&serialPool);
+    for (size_t i = 0; i < words.size(); i++)
+        insertWord(serialRoot, words[i].str, &serialPool);
+    size_t serialLeaves = stressLeaves(serialRoot);
+
+    bool ok = true;
+    for (size_t k = 0; k < opt.threads.size(); k++) {
+        size_t threads = opt.threads[k];
+        char layout[32];
+        snprintf(layout, sizeof(layout), "%zu thread%s", threads, threads > 1 ? "s" : "");
+
+        benchRun(opt, "insertWordConcurrent", layout, d, words.size(), [&]() {
+            arena pool;
+            arenaInit(&pool);
+            trie *root = create(&pool);
+            stressInsert(root, &pool, words, threads, NULL);
+            benchSink = pool.nodes;
+            trieDestroy(root, &pool);
+        });
+        benchRun(opt, "insertWord mutex", layout, d, words.size(), [&]() {
+            arena pool;
+            arenaInit(&pool);
+            trie *root = create(&pool);
+            pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+            stressInsert(root, &pool, words, threads, &lock);
+            benchSink = pool.nodes;
+            trieDestroy(root, &pool);
+        });
+
+        // verify a few more rounds than were timed, races are rare
+        for (int r = 0; r < opt.reps + 2; r++) {
+            arena pool;
+            arenaInit(&pool);
+            trie *root = create(&pool);
+            stressInsert(root, &pool, words, threads, NULL);
+            if (!stressCheck(root, pool, serialPool, serialLeaves, words)) {
+                printf("insertWordConcurrent %s on %s: Trie differs from the serial one\n", layout, d.label.c_str());
+                ok = false;
+            }
+            trieDestroy(root, &pool);
+        }
+    }
+    trieDestroy(serialRoot, &serialPool);
+    return ok;
+}
+
+// parse a comma separated list of counts
+static bool parseList(const char *text, vector<size_t> &list)
+{
+    list.clear();
+    for (const char *p = text; *p != '\0'; ) {
+        char *next;
+        size_t n = strtoul(p, &next, 10);
+        if (next == p)
+            return false;
+        list.push_back(n);
+        p = *next == ',' ? next + 1 : next;
+    }
+    return !list.empty();
+}
+
+static void usage()
+{
+    cerr << "usage: bench [-n N,N,...] [-L min-max] [-d uniform|short] [-c ratio] [-r reps] "
+            "[-s seed] [-k kernel] [-f file]...\n"
+            "       bench -A [-b steps] [-r reps] [-k kernel]\n"
+            "       bench -S [-T N,N,...] [-n N,N,...] [-r reps] [-f file]..." << endl;
+}
+
+int main(int argc, const char * argv[])
+{
+    benchOptions opt;
+    opt.minLen = 3;
+    opt.maxLen = 12;
+    opt.shortWords = false;
+    opt.compound = 0.3;
+    opt.reps = 5;
+    opt.seed = 12345;
+    opt.kernel = NULL;
+    opt.adversarial = false;
+    opt.budget = 1000000;
+    opt.stress = false;
+    bool sizesGiven = false;
+    bool filesGiven = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            sizesGiven = true;
+            if (!parseList(argv[++i], opt.sizes)) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-T") == 0 && i+1 < argc) {
+            if (!parseList(argv[++i], opt.threads) ||
+                *min_element(opt.threads.begin(), opt.threads.end()) < 1) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-S") == 0) {
+            opt.stress = true;
+        } else if (strcmp(argv[i], "-L") == 0 && i+1 < argc) {
+            if (sscanf(argv[++i], "%d-%d", &opt.minLen, &opt.maxLen) != 2 ||
+                opt.minLen < 1 || opt.maxLen < opt.minLen) {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-d") == 0 && i+1 < argc) {
+            // gendict's normal distribution is not generated here
+            const char *name = argv[++i];
+            if (strcmp(name, "uniform") == 0) {
+                opt.shortWords = false;
+            } else if (strcmp(name, "short") == 0) {
+                opt.shortWords = true;
+            } else {
+                usage();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-c") == 0 && i+1 < argc) {
+            opt.compound = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+            opt.reps = max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "-s") == 0 && i+1 < argc) {
+            opt.seed = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-k") == 0 && i+1 < argc) {
+            opt.kernel = argv[++i];
+        } else if (strcmp(argv[i], "-A") == 0) {
+            opt.adversarial = true;
+        } else if (strcmp(argv[i], "-b") == 0 && i+1 < argc) {
+            opt.budget = max(atoll(argv[++i]), 1LL);
+        } else if (strcmp(argv[i], "-f") == 0 && i+1 < argc) {
+            filesGiven = true;
+            opt.files.push_back(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (!sizesGiven) {
+        opt.sizes.push_back(10000);
+        opt.sizes.push_back(100000);
+    }
+    if (opt.threads.empty()) {
+        for (size_t t = 1; t <= 8; t *= 2)
+            opt.threads.push_back(t);
+    }
+    if (!filesGiven && access("wordsforproblem.txt", R_OK) == 0)
+        opt.files.push_back("wordsforproblem.txt");
+
+    printf("%-24s %-13s %-30s %9s %10s %8s %9s\n", "kernel", "layout", "dict", "ops", "ns/op", "stddev", "Mops/s");
+    if (opt.adversarial)
+        return benchAdversarial(opt) ? 0 : 1;
+    // the stress test fails the run when a concurrent Trie is wrong
+    bool ok = true;
+    uint64_t state = opt.seed;
+    for (size_t i = 0; i < opt.sizes.size(); i++) {
+        benchDict d;
+        benchGenerate(&d, opt.sizes[i], opt, state);
+        if (opt.stress)
+            ok = benchStress(opt, d) && ok;
+        else
+            benchDictionary(opt, d);
+        if (d.temporary)
+            unlink(d.path.c_str());
+    }
+    for (size_t i = 0; i < opt.files.size(); i++) {
+        benchDict d;
+        if (!benchLoad(&d, opt.files[i])) {
+            cerr << "cannot read " << opt.files[i] << endl;
+            return 1;
+        }
+        if (opt.stress)
+            ok = benchStress(opt, d) && ok;
+        else
+            benchDictionary(opt, d);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+/**
+* Synthetic dictionary generator for scaling tests
+*
+* with GNU g++
+* -------------
+* g++ -O2 -Wall -o gendict gendict.cpp
+*
+* gendict [-n words] [-L min-max] [-d uniform|short|normal] [-a skew]
+*         [-c ratio] [-p ratio] [-s seed] [-o file]
+* -n: number of words, 1M-100M and more (default 1000000), k/M suffixes allowed
+* -L: length range of the base words (default 3-12)
+* -d: length distribution of the base words (default uniform)
+*     short: skewed to the short end, normal: centered in the range
+* -a: alphabet skew, letter k is drawn with weight 1/(k+1)^skew
+*     (default 0: uniform, 1: roughly English-like)
+* -c: ratio of compound words, made of 2-3 earlier base words (default 0.2)
+* -p: ratio of base words that share a prefix with an earlier word (default 0.5)
+* -s: random seed, the same options and seed give the same file
+* -o: output file (default stdout)
+*/
+
+/**
+ * Words are written as they are generated, one per line, through a 1MB
+ * buffer, so a 100M word dictionary needs no more memory than a small one.
+ * Compounds and shared prefixes pick from a fixed pool of the most recent
+ * base words, which keeps the generator streaming while still giving
+ * concatWord() real segmentations to find. Words may repeat, as in a
+ * merged real word list.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define CHAR_SIZE   26
+#define POOL_WORDS  (1 << 16)
+#define OUT_SIZE    (1 << 20)
+
+enum LengthDist {
+    DIST_UNIFORM,
+    DIST_SHORT,
+    DIST_NORMAL
+};
+
+typedef struct GenOptions {
+    uint64_t words;
+    int minLen;
+    int maxLen;
+    int dist;
+    double skew;
+    double compound;
+    double prefix;
+    uint64_t seed;
+    const char *output;
+}genOptions;
+
+typedef struct Generator {
+    uint64_t state;                 // xorshift64*
+    double letterCdf[CHAR_SIZE];    // cumulative letter weights
+    vector<string> pool;            // recent base words, a ring
+    size_t poolNext;
+}generator;
+
+static uint64_t genRandom(generator *g)
+{
+    g->state ^= g->state >> 12;
+    g->state ^= g->state << 25;
+    g->state ^= g->state >> 27;
+    return g->state * 0x2545f4914f6cdd1dull;
+}
+
+// uniform in [0, 1)
+static double genUniform(generator *g)
+{
+    return (genRandom(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void genInit(generator *g, const genOptions &opt)
+{
+    g->state = opt.seed | 1;
+    double sum = 0;
+    for (int k = 0; k < CHAR_SIZE; k++) {
+        sum += 1.0 / pow(k + 1, opt.skew);
+        g->letterCdf[k] = sum;
+    }
+    for (int k = 0; k < CHAR_SIZE; k++)
+        g->letterCdf[k] /= sum;
+    g->pool.clear();
+    g->poolNext = 0;
+}
+
+static char genLetter(generator *g)
+{
+    double u = genUniform(g);
+    int k = 0;
+    while (k < CHAR_SIZE - 1 && g->letterCdf[k] <= u)
+        k++;
+    return (char)('a' + k);
+}
+
+static int genLength(generator *g, const genOptions &opt)
+{
+    int span = opt.maxLen - opt.minLen + 1;
+    switch (opt.dist) {
+    case DIST_SHORT: {
+        // minimum of two draws
+        int a = (int)(genRandom(g) % span);
+        int b = (int)(genRandom(g) % span);
+        return opt.minLen + min(a, b);
+    }
+    case DIST_NORMAL: {
+        // Irwin-Hall: sum of four uniforms
+        double u = 0;
+        for (int i = 0; i < 4; i++)
+            u += genUniform(g);
+        return opt.minLen + min((int)(u / 4 * span), span - 1);
+    }
+    default:
+        return opt.minLen + (int)(genRandom(g) % span);
+    }
+}
+
+// next base word, possibly extending the prefix of a pooled word
+static void genBase(generator *g, const genOptions &opt, string &word)
+{
+    int len = genLength(g, opt);
+    word.clear();
+    if (!g->pool.empty() && genUniform(g) < opt.prefix) {
+        const string &from = g->pool[genRandom(g) % g->pool.size()];
+        int keep = 1 + (int)(genRandom(g) % min((int)from.size(), len));
+        word.assign(from, 0, keep);
+    }
+    while ((int)word.size() < len)
+        word += genLetter(g);
+
+    if (g->pool.size() < POOL_WORDS) {
+        g->pool.push_back(word);
+    } else {
+        g->pool[g->poolNext] = word;
+        g->poolNext = (g->poolNext + 1) % POOL_WORDS;
+    }
+}
+
+// next word of the dictionary
+static void genWord(generator *g, const genOptions &opt, string &word)
+{
+    if (g->pool.size() > 1 && genUniform(g) < opt.compound) {
+        int parts = 2 + (int)(genRandom(g) % 2);
+        word.clear();
+        for (int i = 0; i < parts; i++)
+            word += g->pool[genRandom(g) % g->pool.size()];
+        return;
+    }
+    genBase(g, opt, word);
+}
+
+// parse a count like 5000000, 5000k or 5M
+static bool parseCount(const char *text, uint64_t &cnt)
+{
+    char *end;
+    double n = strtod(text, &end);
+    if (end == text || n < 0)
+        return false;
+    if (*end == 'k' || *end == 'K')
+        n *= 1e3, end++;
+    else if (*end == 'm' || *end == 'M')
+        n *= 1e6, end++;
+    if (*end != '\0')
+        return false;
+    cnt = (uint64_t)n;
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: gendict [-n words] [-L min-max] [-d uniform|short|normal] [-a skew] "
+                    "[-c ratio] [-p ratio] [-s seed] [-o file]\n");
+}
+
+int main(int argc, const char * argv[])
+{
+    genOptions opt;
+    opt.words = 1000000;
+    opt.minLen = 3;
+    opt.maxLen = 12;
+    opt.dist = DIST_UNIFORM;
+    opt.skew = 0;
+    opt.compound = 0.2;
+    opt.prefix = 0.5;
+    opt.seed = 12345;
+    opt.output = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool ok = i+1 < argc;
+        if (!ok) {
+        } else if (strcmp(argv[i], "-n") == 0) {
+            ok = parseCount(argv[++i], opt.words);
+        } else if (strcmp(argv[i], "-L") == 0) {
+            ok = sscanf(argv[++i], "%d-%d", &opt.minLen, &opt.maxLen) == 2 &&
+                 opt.minLen >= 1 && opt.maxLen >= opt.minLen;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            const char *name = argv[++i];
+            if (strcmp(name, "uniform") == 0)
+                opt.dist = DIST_UNIFORM;
+            else if (strcmp(name, "short") == 0)
+                opt.dist = DIST_SHORT;
+            else if (strcmp(name, "normal") == 0)
+                opt.dist = DIST_NORMAL;
+            else
+                ok = false;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            opt.skew = atof(argv[++i]);
+            ok = opt.skew >= 0;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            opt.compound = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            opt.prefix = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            opt.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            opt.output = argv[++i];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage();
+            return 1;
+        }
+    }
+
+    FILE *fp = opt.output != NULL ? fopen(opt.output, "w") : stdout;
+    if (fp == NULL) {
+        perror(opt.output);
+        return 1;
+    }
+    setvbuf(fp, NULL, _IOFBF, OUT_SIZE);
+
+    generator g;
+    genInit(&g, opt);
+    string word;
+    uint64_t bytes = 0;
+    for (uint64_t i = 0; i < opt.words; i++) {
+        genWord(&g, opt, word);
+        word += '\n';
+        fwrite(word.data(), 1, word.size(), fp);
+        bytes += word.size();
+    }
+    if (fflush(fp) != 0 || (fp != stdout && fclose(fp) != 0)) {
+        perror(opt.output != NULL ? opt.output : "stdout");
+        return 1;
+    }
+    fprintf(stderr, "%llu words, %llu bytes\n", (unsigned long long)opt.words, (unsigned long long)bytes);
+    return 0;
+}
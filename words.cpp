@@ -7,11 +7,11 @@
 *
 * with GNU gcc: 
 * --------------
-* gcc -xc++ -lstdc++ -shared-libgcc words.c
+* gcc -xc++ -O2 -pthread words.c -lstdc++ -shared-libgcc
 *
 * with GNU g++
 * -------------
-* g++ -ggdb -Wall -I. -o output words.cpp
+* g++ -O2 -pthread -ggdb -Wall -I. -o output words.cpp
 */
 
 /**
@@ -54,17 +54,39 @@
  */
 
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <list>
-#include <map>
-#include <set>
-#include <iterator>
+#include <unordered_map>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
 #include <time.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
+// heap allocations, all threads: operator new and heapAlloc()
+static size_t cntAllocs = 0;
+
+// malloc() counted with the allocations of the phase, see PhaseTimer
+static inline void* heapAlloc(size_t size)
+{
+    __atomic_fetch_add(&cntAllocs, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
 /**
  * define character size
  * Each trie node can only contains 'a'-'z' characters. 
@@ -76,36 +98,110 @@ using namespace std;
 // A Trie node
 typedef struct Trie {
     bool isLeaf;
+    int depth;                      // length of the prefix, set by acBuild()
     struct Trie *character[CHAR_SIZE];
+    struct Trie *fail;              // Aho-Corasick links, set by acBuild()
+    struct Trie *output;
 }trie;
 
-// create an empty Trie
-trie* create(trie *node)
+/**
+ * Node arena (slab allocator)
+ * Trie nodes are carved out of large slabs with a bump pointer instead of
+ * a malloc() per node, and the whole trie is released slab by slab,
+ * instead of walking every node recursively.
+ */
+
+#define ARENA_SLAB_NODES    4096
+
+typedef struct ArenaSlab {
+    struct ArenaSlab *next;
+    size_t used;
+    trie node[ARENA_SLAB_NODES];
+}arenaSlab;
+
+typedef struct Arena {
+    arenaSlab *slab;    // current slab, older slabs are chained behind it
+    size_t nodes;       // nodes handed out
+    size_t slabs;       // slabs allocated
+}arena;
+
+// initialize an empty arena
+void arenaInit(arena *pool)
 {
-    if (node == NULL)
-        node = (trie *)malloc(sizeof(trie));
-    
+    pool->slab = NULL;
+    pool->nodes = 0;
+    pool->slabs = 0;
+}
+
+// bump allocate one node, grab a new slab when the current one is full
+trie* arenaAlloc(arena *pool)
+{
+    arenaSlab *slab = pool->slab;
+    if (slab == NULL || slab->used == ARENA_SLAB_NODES) {
+        slab = (arenaSlab *)heapAlloc(sizeof(arenaSlab));
+        slab->next = pool->slab;
+        slab->used = 0;
+        pool->slab = slab;
+        pool->slabs++;
+    }
+    pool->nodes++;
+    return &slab->node[slab->used++];
+}
+
+// release every node of the arena at once
+void arenaRelease(arena *pool)
+{
+    arenaSlab *slab = pool->slab;
+    while (slab != NULL) {
+        arenaSlab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    arenaInit(pool);
+}
+
+// move every node of src into dst, src is left empty
+void arenaMerge(arena *dst, arena *src)
+{
+    if (src->slab == NULL)
+        return;
+    if (dst->slab == NULL) {
+        dst->slab = src->slab;
+    } else {
+        // behind the current slab of dst, which keeps allocating
+        arenaSlab *tail = src->slab;
+        while (tail->next != NULL)
+            tail = tail->next;
+        tail->next = dst->slab->next;
+        dst->slab->next = src->slab;
+    }
+    dst->nodes += src->nodes;
+    dst->slabs += src->slabs;
+    arenaInit(src);
+}
+
+// create an empty Trie node
+trie* create(arena *pool)
+{
+    trie *node = arenaAlloc(pool);
     node->isLeaf = false;
+    node->depth = 0;
     for (int i=0; i < CHAR_SIZE; i++)
         node->character[i] = NULL;
+    node->fail = NULL;
+    node->output = NULL;
     return node;
 }
 
-// destroy the Trie
-void trieDestroy(trie* &node)
+// destroy the Trie: all of its nodes live in the arena
+void trieDestroy(trie* &node, arena *pool)
 {
-    if (node == NULL)
-        return;
-    for (int i=0; i < CHAR_SIZE; i++) {
-        trieDestroy(node->character[i]);
-    }
-    // deallocate memory block
-    free(node);
+    arenaRelease(pool);
     node = NULL;
 }
 
 // add a word into Trie
-trie* insertWord(trie *node, const char *str)
+trie* insertWord(trie *node, const char *str, arena *pool)
 {
     if(str[0] == '\0') {
         node->isLeaf = true;
@@ -113,14 +209,58 @@ trie* insertWord(trie *node, const char *str)
         int ch = str[0] - 'a';
         trie* &edge = node->character[ch];
         if ( edge == NULL) {
-            edge = create(edge);
+            edge = create(pool);
         }
         str++;
-        edge = insertWord(edge, str);
+        edge = insertWord(edge, str, pool);
     }
     return node;
 }
 
+/**
+ * Concurrent insert
+ * Several threads may add words to the same Trie at once, without a lock:
+ * an empty child slot is claimed with a compare-and-swap of a new node, a
+ * thread that loses the race gives its node back and follows the winner's,
+ * and isLeaf is set with an atomic store. Nodes are published with release
+ * ordering, so a thread that sees the pointer sees an initialized node.
+ * pool must be owned by the calling thread; merge the thread arenas with
+ * arenaMerge() once every thread is done. Readers other than concurrent
+ * inserters must wait until then.
+ */
+
+// give back the node last allocated from pool
+void arenaUndo(arena *pool, trie *node)
+{
+    arenaSlab *slab = pool->slab;
+    if (slab != NULL && slab->used > 0 && &slab->node[slab->used - 1] == node) {
+        slab->used--;
+        pool->nodes--;
+    }
+}
+
+// add a word into Trie, safe against other threads doing the same
+trie* insertWordConcurrent(trie *node, const char *str, arena *pool)
+{
+    trie *cur = node;
+    for (; *str != '\0'; str++) {
+        trie **edge = &cur->character[*str - 'a'];
+        trie *next = __atomic_load_n(edge, __ATOMIC_ACQUIRE);
+        if (next == NULL) {
+            trie *fresh = create(pool);
+            if (__atomic_compare_exchange_n(edge, &next, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                next = fresh;
+            } else {
+                // another thread got there first, next is its node
+                arenaUndo(pool, fresh);
+            }
+        }
+        cur = next;
+    }
+    __atomic_store_n(&cur->isLeaf, true, __ATOMIC_RELEASE);
+    return node;
+}
+
 /**
  * search a break in the leaf (word break) until found
  * returns true if string can be segmented into space separated
@@ -149,156 +289,2910 @@ bool isLeafBreak(trie *node, const char *str, int start, int end, int &mid)
     mid = end;
     return subnode->isLeaf;
 }
+
+// walk primitives for the segmentation engine
+inline const trie* trieRoot(const trie *node)
+{
+    return node;
+}
+
+inline const trie* trieNext(const trie *node, const trie *cur, int ch)
+{
+    return cur->character[ch];
+}
+
+inline bool trieIsLeaf(const trie *node, const trie *cur)
+{
+    return cur->isLeaf;
+}
+
 /**
- * decide a word whether are made of other words
- * return count of subwords
- * sorted by length, began with the longest length
- * used recursive function and used "isLeafBreak()" to search subword break
- * position for better performance.
- */ 
-int concatWord(trie *node, const char *str, int start, int end, bool &result)
+ * Aho-Corasick automaton
+ * isLeafBreak() and the segmentation walk the Trie from the root again
+ * for every start offset. acBuild() adds two links to every node of a
+ * finished pointer Trie in one breadth-first pass: fail, the node of the
+ * longest proper suffix of its prefix that is also in the Trie, and
+ * output, the nearest node down that chain that ends a word. A scan then
+ * reads the text once from left to right, follows the fail links on a
+ * mismatch instead of going back, and finds the words ending at each
+ * position on the output chain of the current node: O(text + matches).
+ * The children are left as they are, so every other use of the Trie works
+ * unchanged; no word may be inserted after acBuild().
+ */
+
+// add the fail and output links, after the last word is inserted
+void acBuild(trie *root)
 {
-    result = false;
+    vector<trie*> queue;
+    root->depth = 0;
+    root->fail = root;
+    root->output = NULL;
+    queue.push_back(root);
+    for (size_t head = 0; head < queue.size(); head++) {
+        trie *node = queue[head];
+        for (int ch = 0; ch < CHAR_SIZE; ch++) {
+            trie *child = node->character[ch];
+            if (child == NULL)
+                continue;
+            child->depth = node->depth + 1;
+            trie *fail = node->fail;
+            while (node != root && fail != root && fail->character[ch] == NULL)
+                fail = fail->fail;
+            child->fail = node != root && fail->character[ch] != NULL ? fail->character[ch] : root;
+            child->output = child->fail->isLeaf ? child->fail : child->fail->output;
+            queue.push_back(child);
+        }
+    }
+    // the root ends no word, an empty line of the input aside
+    for (size_t i = 1; i < queue.size(); i++) {
+        if (queue[i]->output == root)
+            queue[i]->output = NULL;
+    }
+}
 
-    // validate input
-    if (start > end) {
-        return 0;
+// next state of the automaton after letter ch
+inline const trie* acNext(const trie *root, const trie *cur, int ch)
+{
+    while (cur != root && cur->character[ch] == NULL)
+        cur = cur->fail;
+    const trie *next = cur->character[ch];
+    return next != NULL ? next : root;
+}
+
+/**
+ * find every word of the Trie in text[0..len-1] in one pass, report(end,
+ * length) gets each match with the offset of its last letter, the longest
+ * first at each offset. Upper case letters match as lower case, any other
+ * byte ends all matches, so text can be a whole corpus.
+ * returns the number of matches
+ */
+template <class F>
+size_t acScan(const trie *root, const char *text, size_t len, F report)
+{
+    size_t found = 0;
+    const trie *cur = root;
+    for (size_t i = 0; i < len; i++) {
+        int ch = (unsigned char)text[i];
+        if (ch >= 'A' && ch <= 'Z')
+            ch += 'a' - 'A';
+        if (ch < 'a' || ch > 'z') {
+            cur = root;
+            continue;
+        }
+        cur = acNext(root, cur, ch - 'a');
+        for (const trie *hit = cur->isLeaf ? cur : cur->output; hit != NULL; hit = hit->output) {
+            report(i, hit->depth);
+            found++;
+        }
     }
+    return found;
+}
+
+/**
+ * fewest subwords of str[start..end] split into two or more words, from
+ * one Aho-Corasick pass over the word instead of a Trie walk per offset;
+ * like concatWord(), 1 for a word that does not split, and 0 with result
+ * false when it is not made of words
+ * ends (optional): gets the subword ends, room for end - start + 1 entries
+ */
+int acConcatWord(trie *root, const char *str, int start, int end, bool &result, int *ends = NULL)
+{
+    result = false;
+    if (start > end)
+        return 0;
+    static thread_local vector<int> scratch;
+    size_t len = end - start + 2;
+    if (scratch.size() < 2 * len)
+        scratch.resize(2 * len);
+    // reach[i]: 1 + fewest subwords of str[start..i-1], 0: no split
+    // from[i]: start of the last of them; both by position
+    int *reach = &scratch[0] - start;
+    int *from = reach + len;
+    reach[start] = 1;
+    for (int i = start + 1; i <= end + 1; i++)
+        reach[i] = 0;
+
+    bool whole = false;
+    const trie *cur = root;
     for (int i = start; i <= end; i++) {
-        bool bPartOne = isLeafBreak(node, str, start, end, i);
-        
-        if (i == end) {
-            result = bPartOne;
-            return (bPartOne ? 1 : 0);
+        cur = acNext(root, cur, str[i] - 'a');
+        for (const trie *hit = cur->isLeaf ? cur : cur->output; hit != NULL; hit = hit->output) {
+            int s = i - hit->depth + 1;
+            // the word itself is no segmentation
+            if (s == start && i == end) {
+                whole = true;
+                continue;
+            }
+            if (reach[s] == 0)
+                continue;
+            if (reach[i+1] == 0 || reach[s] + 1 < reach[i+1]) {
+                reach[i+1] = reach[s] + 1;
+                from[i+1] = s;
+            }
         }
-        
-        // start the second part match
-        bool bPartTwo = false;
-        int cntWords = concatWord(node, str, i+1, end, bPartTwo);
-        if (bPartOne && bPartTwo) {
-            result = true;
-            return 1 + cntWords;
+    }
+    if (reach[end+1] == 0) {
+        result = whole;
+        if (whole && ends != NULL)
+            ends[0] = end;
+        return whole;
+    }
+    result = true;
+    int parts = reach[end+1] - 1;
+    for (int i = end + 1, k = parts - 1; ends != NULL && i > start; i = from[i], k--)
+        ends[k] = i - 1;
+    return parts;
+}
+/**
+ * Compact Trie
+ * Same shape as the Trie above, but the nodes live in one contiguous vector
+ * and refer to their children by 32-bit index instead of by pointer, which
+ * halves the node size (104 instead of 232 bytes) and keeps a word walk
+ * inside fewer cache lines.
+ * The root is node 0 and can never be a child, so index 0 also means
+ * "no child"; isLeaf is packed into the spare top bit of the first slot.
+ */
+
+#define CTRIE_LEAF      0x80000000u
+#define CTRIE_INDEX     0x7fffffffu
+
+// A compact Trie node
+typedef struct CompactNode {
+    uint32_t character[CHAR_SIZE];
+}cnode;
+
+typedef struct CompactTrie {
+    vector<cnode> node;
+}ctrie;
+
+inline uint32_t cnodeChild(const cnode &n, int ch)
+{
+    return n.character[ch] & CTRIE_INDEX;
+}
+
+inline bool cnodeIsLeaf(const cnode &n)
+{
+    return (n.character[0] & CTRIE_LEAF) != 0;
+}
+
+// append an empty node, return its index
+uint32_t ctrieCreate(ctrie *t)
+{
+    cnode n;
+    memset(&n, 0, sizeof(n));
+    t->node.push_back(n);
+    return (uint32_t)(t->node.size() - 1);
+}
+
+// create an empty compact Trie with its root
+ctrie* create(ctrie *t)
+{
+    t->node.clear();
+    ctrieCreate(t);
+    return t;
+}
+
+// destroy the compact Trie
+void trieDestroy(ctrie *t)
+{
+    vector<cnode>().swap(t->node);
+}
+
+// add a word into compact Trie
+ctrie* insertWord(ctrie *t, const char *str)
+{
+    uint32_t cur = 0;
+    for (; *str != '\0'; str++) {
+        int ch = *str - 'a';
+        uint32_t next = cnodeChild(t->node[cur], ch);
+        if (next == 0) {
+            // vector may move: take the index before writing the slot
+            next = ctrieCreate(t);
+            t->node[cur].character[ch] |= next;
         }
+        cur = next;
     }
-    return 0;
+    t->node[cur].character[0] |= CTRIE_LEAF;
+    return t;
+}
+
+// count the nodes of a pointer Trie
+static size_t trieCount(const trie *node)
+{
+    size_t cnt = 1;
+    for (int i=0; i < CHAR_SIZE; i++) {
+        if (node->character[i] != NULL)
+            cnt += trieCount(node->character[i]);
+    }
+    return cnt;
+}
+
+// copy the subtree of a pointer Trie node in depth-first order
+static uint32_t ctrieCopy(ctrie *t, const trie *src)
+{
+    uint32_t cur = ctrieCreate(t);
+    if (src->isLeaf)
+        t->node[cur].character[0] |= CTRIE_LEAF;
+    for (int i=0; i < CHAR_SIZE; i++) {
+        if (src->character[i] != NULL) {
+            uint32_t child = ctrieCopy(t, src->character[i]);
+            t->node[cur].character[i] |= child;
+        }
+    }
+    return cur;
 }
 
 /**
- * read words from input file
- * into trie data structure
- * assume input lowercase words, nospaces, on word perline
- * read the input text file line by line, while building a Trie tree.
+ * build a compact Trie from a pointer Trie
+ * depth-first numbering puts the first child right after its parent
  */
+ctrie* create(ctrie *t, const trie *root)
+{
+    t->node.clear();
+    t->node.reserve(trieCount(root));
+    ctrieCopy(t, root);
+    return t;
+}
 
-typedef list<string> StringList;
-int ReadWordFile(const char *filename, trie* &root, map<size_t, StringList> &wordsWithSameLen, set<size_t> &LengthSet)
+// same as isLeafBreak() above, on a compact Trie
+bool isLeafBreak(ctrie *t, const char *str, int start, int end, int &mid)
 {
-    root = NULL;
-    root = create(root);
-    int cntWords = 0;
-    // ifstream: stream class used for file handling
-    ifstream ifs(filename, ifstream::in);
-    istream_iterator<string> itr_word(ifs), itr_word_end;
-    for (; itr_word != itr_word_end; itr_word++, cntWords++ ) {
-        /**
-         * c_str returns a const char* 
-         * that points to a null-terminated string
-         * caution: assume input lowercase words, 
-         * nospaces, and word perline
-         */
-        insertWord(root, (*itr_word).c_str());  
-        size_t len = itr_word->size();
-        wordsWithSameLen[len].push_back(*itr_word);
-        LengthSet.insert(len);
-    }
-    ifs.close();
-    return cntWords;
+    const cnode *nodes = &t->node[0];
+    const cnode *subnode = nodes;
+    const char *pch = str + start;
+    int i;
+    for (i=start; i<=end; i++) {
+        uint32_t next = cnodeChild(*subnode, *pch - 'a');
+        if (next == 0) {
+            // no match found
+            return false;
+        }
+        pch++;
+        subnode = nodes + next;
+        // first position where >= mid)
+        if (i >= mid && cnodeIsLeaf(*subnode)) {
+            mid = i;
+            // found a match
+            return true;
+        }
+    }
+    mid = end;
+    return cnodeIsLeaf(*subnode);
 }
 
-int main(int argc, const char * argv[])
+// walk primitives for the segmentation engine
+inline const cnode* trieRoot(const ctrie *t)
 {
-    if (argc <= 1) {
-        cout << "default name: wordsforproblem.txt\n";
+    return &t->node[0];
+}
+
+inline const cnode* trieNext(const ctrie *t, const cnode *cur, int ch)
+{
+    uint32_t next = cnodeChild(*cur, ch);
+    return next == 0 ? NULL : &t->node[next];
+}
+
+inline bool trieIsLeaf(const ctrie *t, const cnode *cur)
+{
+    return cnodeIsLeaf(*cur);
+}
+
+/**
+ * Bitmap Trie
+ * Most nodes below depth 3 have only one or two children, so instead of a
+ * 26-slot array every node keeps a 26-bit child-presence mask, and its
+ * children are stored next to each other in the node vector, in letter
+ * order: the child for letter c is node[child + popcount(mask & ((1<<c)-1))].
+ * A node is 8 bytes; isLeaf is packed into the top bit of the mask.
+ */
+
+#define BTRIE_LEAF      0x80000000u
+#define BTRIE_MASK      0x03ffffffu
+
+// A bitmap Trie node
+typedef struct BitmapNode {
+    uint32_t mask;      // bit c: has a child for 'a'+c, top bit: isLeaf
+    uint32_t child;     // index of the first child
+}bnode;
+
+typedef struct BitmapTrie {
+    vector<bnode> node;                 // node 0 is the root
+    vector<uint32_t> free[CHAR_SIZE+1]; // retired child blocks, by size
+}btrie;
+
+// index of the child for letter ch, 0 if there is none
+inline uint32_t bnodeChild(const bnode &n, int ch)
+{
+    uint32_t bit = 1u << ch;
+    if ((n.mask & bit) == 0)
+        return 0;
+    return n.child + __builtin_popcount(n.mask & (bit - 1));
+}
+
+inline bool bnodeIsLeaf(const bnode &n)
+{
+    return (n.mask & BTRIE_LEAF) != 0;
+}
+
+// allocate a block of cnt sibling nodes, reuse a retired block if any
+static uint32_t btrieAlloc(btrie *t, int cnt)
+{
+    if (!t->free[cnt].empty()) {
+        uint32_t block = t->free[cnt].back();
+        t->free[cnt].pop_back();
+        return block;
     }
+    bnode n = {0, 0};
+    uint32_t block = (uint32_t)t->node.size();
+    t->node.insert(t->node.end(), cnt, n);
+    return block;
+}
 
-    // default file name with words (input file)
-    const char *filename = "wordsforproblem.txt";
-    
-    if (argc > 1) {
-        filename = argv[1];
+// create an empty bitmap Trie with its root
+btrie* create(btrie *t)
+{
+    t->node.clear();
+    for (int i=0; i <= CHAR_SIZE; i++)
+        t->free[i].clear();
+    btrieAlloc(t, 1);
+    return t;
+}
+
+// destroy the bitmap Trie
+void trieDestroy(btrie *t)
+{
+    vector<bnode>().swap(t->node);
+    for (int i=0; i <= CHAR_SIZE; i++)
+        vector<uint32_t>().swap(t->free[i]);
+}
+
+/**
+ * add a word into bitmap Trie
+ * a missing child moves the siblings into a block one node larger,
+ * the old block is kept for reuse
+ */
+btrie* insertWord(btrie *t, const char *str)
+{
+    uint32_t cur = 0;
+    for (; *str != '\0'; str++) {
+        int ch = *str - 'a';
+        uint32_t next = bnodeChild(t->node[cur], ch);
+        if (next == 0) {
+            bnode n = t->node[cur];
+            uint32_t bit = 1u << ch;
+            int cnt = __builtin_popcount(n.mask & BTRIE_MASK);
+            int rank = __builtin_popcount(n.mask & (bit - 1));
+            uint32_t block = btrieAlloc(t, cnt + 1);
+            bnode *nodes = &t->node[0];
+            for (int i=0; i < rank; i++)
+                nodes[block + i] = nodes[n.child + i];
+            nodes[block + rank].mask = 0;
+            nodes[block + rank].child = 0;
+            for (int i=rank; i < cnt; i++)
+                nodes[block + i + 1] = nodes[n.child + i];
+            if (cnt > 0)
+                t->free[cnt].push_back(n.child);
+            nodes[cur].mask = n.mask | bit;
+            nodes[cur].child = block;
+            next = block + rank;
+        }
+        cur = next;
     }
-    
-    // params to calculate execution time
-    clock_t start, end;
-    double cpu_time_used;
-    
-    // this is the root of Trie
-    trie *root = NULL;
+    t->node[cur].mask |= BTRIE_LEAF;
+    return t;
+}
 
-    /**
-     * map words by grouping with the same length
-     * and sort by length of words
-     */
+// copy the children of a pointer Trie node, each block right before its subtrees
+static void btrieCopy(btrie *t, uint32_t cur, const trie *src)
+{
+    uint32_t mask = src->isLeaf ? BTRIE_LEAF : 0;
+    int cnt = 0;
+    for (int i=0; i < CHAR_SIZE; i++) {
+        if (src->character[i] != NULL) {
+            mask |= 1u << i;
+            cnt++;
+        }
+    }
+    uint32_t block = cnt > 0 ? btrieAlloc(t, cnt) : 0;
+    t->node[cur].mask = mask;
+    t->node[cur].child = block;
+    for (int i=0; i < CHAR_SIZE; i++) {
+        if (src->character[i] != NULL)
+            btrieCopy(t, block++, src->character[i]);
+    }
+}
 
-    map<size_t, StringList> mapWordsWithSameLen;
-    set<size_t> LengthSet;
+// build a bitmap Trie from a pointer Trie
+btrie* create(btrie *t, const trie *root)
+{
+    create(t);
+    t->node.reserve(trieCount(root));
+    btrieCopy(t, 0, root);
+    return t;
+}
 
-    start = clock();
-    int cntWords = ReadWordFile(filename, root, mapWordsWithSameLen, LengthSet);
-    cout << "Input words: " << cntWords << endl;
-    // block following lines to include perf for fn: ReadWordFile 
-    start = clock();
+// same as isLeafBreak() above, on a bitmap Trie
+bool isLeafBreak(btrie *t, const char *str, int start, int end, int &mid)
+{
+    const bnode *nodes = &t->node[0];
+    const bnode *subnode = nodes;
+    const char *pch = str + start;
+    int i;
+    for (i=start; i<=end; i++) {
+        uint32_t next = bnodeChild(*subnode, *pch - 'a');
+        if (next == 0) {
+            // no match found
+            return false;
+        }
+        pch++;
+        subnode = nodes + next;
+        // first position where >= mid)
+        if (i >= mid && bnodeIsLeaf(*subnode)) {
+            mid = i;
+            // found a match
+            return true;
+        }
+    }
+    mid = end;
+    return bnodeIsLeaf(*subnode);
+}
 
-    int foundWords = 0;
-    int cntConcat = 0;
-    set<size_t>::reverse_iterator rit;
+// walk primitives for the segmentation engine
+inline const bnode* trieRoot(const btrie *t)
+{
+    return &t->node[0];
+}
 
-    // output file: result
-    const char* foundWordsFileName = "output_wordsforproblem.txt";
-    ofstream foundWordsFile(foundWordsFileName);
+inline const bnode* trieNext(const btrie *t, const bnode *cur, int ch)
+{
+    uint32_t next = bnodeChild(*cur, ch);
+    return next == 0 ? NULL : &t->node[next];
+}
 
-    /**
-     * first begin with the longest length
-     * rbegin: returns a reverse iterator pointing to the last element in the container
-     * rend: returns a reverse iterator pointing to the theoretical element 
-     * right before the first element in the array
-     */
+inline bool trieIsLeaf(const btrie *t, const bnode *cur)
+{
+    return bnodeIsLeaf(*cur);
+}
 
-    for (rit = LengthSet.rbegin(); rit != LengthSet.rend(); rit++) { 
-        size_t len = *rit;
-        StringList& dict = mapWordsWithSameLen[len];
+/**
+ * DAWG (directed acyclic word graph)
+ * The prefix Trie repeats every common suffix (-ing, -ed, -ness, ...) once
+ * per word. Built from sorted input with Daciuk's incremental algorithm,
+ * equivalent states are merged as soon as they can no longer change, which
+ * gives the minimal automaton with the same membership as the Trie.
+ * It is stored in the bitmap Trie layout: the labels of a state are in its
+ * mask and its children are a block of records, so merging states just
+ * means sharing child blocks. A DAWG is read-only, never insertWord() into it.
+ */
 
-        // loop all of the same length
-        for (StringList::const_iterator it=dict.begin(); it!=dict.end(); it++) { 
-            bool found = false;
-            cntConcat = concatWord(root, it->c_str(), 0, (int)it->size()-1, found);
-
-            // output this
-            if (found && cntConcat > 1) { 
-                if(foundWords==0)cout << "The longest output: " << *it << endl;
-                else if(foundWords==1)cout << "The second longest longest output: " << *it << endl;
-                foundWords++;
-                foundWordsFile << *it << endl;
-            }
+// a state on the path of the last word, not merged yet
+typedef struct DawgState {
+    uint32_t mask;
+    vector<bnode> child;    // merged children, in letter order
+}dawgState;
+
+typedef unordered_map<string, uint32_t> dawgRegister;
+
+// merge a finished state: reuse an equal child block or add it
+static bnode dawgFreeze(btrie *t, dawgRegister &reg, const dawgState &st)
+{
+    bnode n = {st.mask, 0};
+    if (!st.child.empty()) {
+        string key((const char *)&st.child[0], st.child.size() * sizeof(bnode));
+        dawgRegister::iterator it = reg.find(key);
+        if (it != reg.end()) {
+            n.child = it->second;
+        } else {
+            n.child = (uint32_t)t->node.size();
+            t->node.insert(t->node.end(), st.child.begin(), st.child.end());
+            reg[key] = n.child;
         }
     }
+    return n;
+}
 
-    /**
-     * The output will show following things:
-     * (1) Total number of words in the input file
-     * (2) The longest output, The second longest output:
-     * (3) Total words found
-     * (4) And total execution time
-     */
+/**
+ * build a minimized DAWG into a bitmap Trie
+ * words must be sorted (strcmp order), duplicates are fine
+ */
+btrie* createDawg(btrie *t, const vector<const char*> &words)
+{
+    create(t);
+    dawgRegister reg;
+    // path[d]: state reached by the first d letters of the last word
+    vector<dawgState> path(1);
+    path[0].mask = 0;
+    const char *prev = "";
+    size_t prevLen = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+        const char *str = words[i];
+        size_t len = strlen(str);
+        size_t common = 0;
+        while (common < prevLen && prev[common] == str[common])
+            common++;
+        // the states past the common prefix are finished
+        for (size_t d = prevLen; d > common; d--) {
+            path[d-1].child.push_back(dawgFreeze(t, reg, path[d]));
+        }
+        if (path.size() < len + 1)
+            path.resize(len + 1);
+        for (size_t d = common + 1; d <= len; d++) {
+            path[d-1].mask |= 1u << (str[d-1] - 'a');
+            path[d].mask = 0;
+            path[d].child.clear();
+        }
+        path[len].mask |= BTRIE_LEAF;
+        prev = str;
+        prevLen = len;
+    }
+    for (size_t d = prevLen; d > 0; d--) {
+        path[d-1].child.push_back(dawgFreeze(t, reg, path[d]));
+    }
+    t->node[0] = dawgFreeze(t, reg, path[0]);
+    return t;
+}
 
-    end = clock();
-    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
-    cout << "Seconds to execute: " << cpu_time_used << endl; 
-    cout << "Total Found words: " << foundWords << endl;
+/**
+ * Double-Array Trie
+ * The dictionary is static once loaded, so the Trie can be frozen into two
+ * flat int arrays: state s moves on code c to t = base[s] + c when
+ * check[t] == s, two array reads and no pointer chasing.
+ * Letters use codes 1..26 and code 0 marks the end of a word, so s is a
+ * leaf when check[base[s]] == s. The root is state 1, slot 0 is never
+ * used, and check[] == 0 marks a free slot.
+ */
 
-    // deallocate memory block
-    trieDestroy(root);
-    
-    return 0;
+#define DATRIE_ROOT     1
+#define DATRIE_DENSITY  0.95
+
+typedef struct DoubleArrayTrie {
+    vector<int> base;
+    vector<int> check;
+    int nextCheck;      // build only: scanning for a free base starts here
+}datrie;
+
+// the next state on letter ch, 0 if there is none
+inline int datrieNext(const int *base, const int *check, int s, int ch)
+{
+    int t = base[s] + ch + 1;
+    return check[t] == s ? t : 0;
 }
 
+inline bool datrieIsLeaf(const int *base, const int *check, int s)
+{
+    return check[base[s]] == s;
+}
+
+/**
+ * find a base where every child code lands on a free slot
+ * codes are ascending, the arrays grow on demand and always keep
+ * CHAR_SIZE+1 spare slots past the last base, so lookups need no
+ * bounds check
+ */
+static int datrieFindBase(datrie *t, const int *code, int cnt)
+{
+    int pos = t->nextCheck;
+    int occupied = 0;
+    bool first = true;
+    for (;; pos++) {
+        if ((size_t)pos >= t->check.size()) {
+            t->base.resize(pos + CHAR_SIZE + 2, 0);
+            t->check.resize(pos + CHAR_SIZE + 2, 0);
+        }
+        if (t->check[pos] != 0) {
+            occupied++;
+            continue;
+        } else if (first) {
+            t->nextCheck = pos;
+            first = false;
+        }
+        int b = pos - code[0];
+        if (b < 2)
+            continue;
+        if ((size_t)(b + CHAR_SIZE + 2) > t->check.size()) {
+            t->base.resize(b + CHAR_SIZE + 2, 0);
+            t->check.resize(b + CHAR_SIZE + 2, 0);
+        }
+        int i;
+        for (i = 1; i < cnt; i++) {
+            if (t->check[b + code[i]] != 0)
+                break;
+        }
+        if (i == cnt) {
+            // skip densely packed ranges on the next search
+            if ((double)occupied / (pos - t->nextCheck + 1) >= DATRIE_DENSITY)
+                t->nextCheck = pos;
+            return b;
+        }
+    }
+}
+
+// place the children of state s: the words in [lo, hi) sharing depth letters
+static void datrieBuild(datrie *t, const vector<const char*> &words, size_t lo, size_t hi, int depth, int s)
+{
+    int code[CHAR_SIZE+1];
+    size_t from[CHAR_SIZE+2];
+    int cnt = 0;
+    for (size_t i = lo; i < hi; i++) {
+        int c = words[i][depth] == '\0' ? 0 : words[i][depth] - 'a' + 1;
+        if (cnt == 0 || code[cnt-1] != c) {
+            code[cnt] = c;
+            from[cnt] = i;
+            cnt++;
+        }
+    }
+    from[cnt] = hi;
+
+    int b = datrieFindBase(t, code, cnt);
+    t->base[s] = b;
+    for (int i = 0; i < cnt; i++)
+        t->check[b + code[i]] = s;
+    for (int i = 0; i < cnt; i++) {
+        if (code[i] != 0)
+            datrieBuild(t, words, from[i], from[i+1], depth+1, b + code[i]);
+    }
+}
+
+/**
+ * build a double-array Trie
+ * words must be sorted (strcmp order), duplicates are fine
+ */
+datrie* create(datrie *t, const vector<const char*> &words)
+{
+    t->base.assign(DATRIE_ROOT + CHAR_SIZE + 2, 0);
+    t->check.assign(DATRIE_ROOT + CHAR_SIZE + 2, 0);
+    t->check[DATRIE_ROOT] = -1;
+    t->nextCheck = DATRIE_ROOT + 1;
+    if (!words.empty())
+        datrieBuild(t, words, 0, words.size(), 0, DATRIE_ROOT);
+    return t;
+}
+
+// destroy the double-array Trie
+void trieDestroy(datrie *t)
+{
+    vector<int>().swap(t->base);
+    vector<int>().swap(t->check);
+}
+
+// same as isLeafBreak() above, on a double-array Trie
+bool isLeafBreak(datrie *t, const char *str, int start, int end, int &mid)
+{
+    const int *base = &t->base[0];
+    const int *check = &t->check[0];
+    int s = DATRIE_ROOT;
+    const char *pch = str + start;
+    int i;
+    for (i=start; i<=end; i++) {
+        s = datrieNext(base, check, s, *pch - 'a');
+        if (s == 0) {
+            // no match found
+            return false;
+        }
+        pch++;
+        // first position where >= mid)
+        if (i >= mid && datrieIsLeaf(base, check, s)) {
+            mid = i;
+            // found a match
+            return true;
+        }
+    }
+    mid = end;
+    return datrieIsLeaf(base, check, s);
+}
+
+// walk primitives for the segmentation engine, state 0 is "no state"
+inline int trieRoot(const datrie *t)
+{
+    return DATRIE_ROOT;
+}
+
+inline int trieNext(const datrie *t, int cur, int ch)
+{
+    return datrieNext(&t->base[0], &t->check[0], cur, ch);
+}
+
+inline bool trieIsLeaf(const datrie *t, int cur)
+{
+    return datrieIsLeaf(&t->base[0], &t->check[0], cur);
+}
+
+/**
+ * find every break in the leaf from start in a single walk
+ * writes, in ascending order, each position e in [start, end] where a
+ * word str[start..e] ends, returns how many were found
+ */
+template <class T>
+int leafBreaks(T *node, const char *str, int start, int end, int *ends)
+{
+    int cnt = 0;
+    auto subnode = trieRoot(node);
+    for (int i = start; i <= end; i++) {
+        subnode = trieNext(node, subnode, str[i] - 'a');
+        if (!subnode)
+            break;
+        if (trieIsLeaf(node, subnode))
+            ends[cnt++] = i;
+    }
+    return cnt;
+}
+
+/**
+ * same single walk, as a bitmask
+ * bit k is set when a word str[start..start+k] ends, only the first
+ * 64 letters from start are walked
+ */
+template <class T>
+uint64_t leafBreakMask(T *node, const char *str, int start, int end)
+{
+    uint64_t mask = 0;
+    if (end - start >= 64)
+        end = start + 63;
+    auto subnode = trieRoot(node);
+    for (int i = start; i <= end; i++) {
+        subnode = trieNext(node, subnode, str[i] - 'a');
+        if (!subnode)
+            break;
+        if (trieIsLeaf(node, subnode))
+            mask |= (uint64_t)1 << (i - start);
+    }
+    return mask;
+}
+
+/**
+ * Step budget
+ * A word like "aaaa...ab" over the dictionary {a, aa, aaa, ...} costs the
+ * recursion exponential time and the dynamic programming O(L^2), so one
+ * bad word can stall a worker. With a budget every Trie step is paid from
+ * it and the word is given up once it runs out: the search returns
+ * CONCAT_TIMED_OUT instead of a count. NULL: no budget.
+ * The recursion is never run without one: each call is charged its whole
+ * suffix, so a budget of B steps also keeps it under sqrt(2B) calls deep,
+ * which RECURSIVE_BUDGET keeps well inside a thread stack.
+ */
+#define CONCAT_TIMED_OUT    (-1)
+#define RECURSIVE_BUDGET    100000000
+
+/**
+ * decide a word whether are made of other words
+ * return count of subwords
+ * sorted by length, began with the longest length
+ * used recursive function and used "leafBreaks()" to find all subword
+ * break positions of a start in one walk, shortest first.
+ * exponential in the worst case (e.g. "aaaa...ab"), kept as the reference
+ * for concatWord() below
+ * budget: remaining steps, see above
+ */ 
+template <class T>
+int concatWordRecursive(T *node, const char *str, int start, int end, bool &result, int64_t *budget = NULL)
+{
+    result = false;
+
+    // validate input
+    if (start > end) {
+        return 0;
+    }
+    // a walk is charged for every letter it may take
+    if (budget != NULL && (*budget -= end - start + 1) < 0)
+        return CONCAT_TIMED_OUT;
+
+    // break positions: a bitmask for short words, a list otherwise
+    uint64_t mask = 0;
+    int *ends = NULL;
+    int cntEnds = 0;
+    if (end - start < 64) {
+        mask = leafBreakMask(node, str, start, end);
+    } else {
+        ends = (int *)heapAlloc((end - start + 1) * sizeof(int));
+        cntEnds = leafBreaks(node, str, start, end, ends);
+    }
+
+    int cntWords = 0;
+    for (int k = 0; ends != NULL ? k < cntEnds : mask != 0; k++) {
+        int i;
+        if (ends != NULL) {
+            i = ends[k];
+        } else {
+            i = start + __builtin_ctzll(mask);
+            mask &= mask - 1;
+        }
+
+        if (i == end) {
+            result = true;
+            cntWords = 1;
+            break;
+        }
+
+        // start the second part match
+        bool bPartTwo = false;
+        int cnt = concatWordRecursive(node, str, i+1, end, bPartTwo, budget);
+        if (cnt == CONCAT_TIMED_OUT) {
+            cntWords = CONCAT_TIMED_OUT;
+            break;
+        }
+        if (bPartTwo) {
+            result = true;
+            cntWords = 1 + cnt;
+            break;
+        }
+    }
+    free(ends);
+    return cntWords;
+}
+
+/**
+ * Suffix cache
+ * Whether str[p..end] can be split, and into how many subwords, depends on
+ * the suffix alone, so results are shared across all the words of a run:
+ * "nesses" or "ableness" is solved once, not once per word ending with it.
+ * Open addressing on a 64-bit hash of the suffix letters plus its length;
+ * an entry points at its suffix, in place in the word buffer, and a hit
+ * compares the letters too, so a hash collision is never taken for a match.
+ * The words must stay where they are while the cache is used; cacheClear()
+ * empties it when their buffer is reused.
+ * Suffixes shorter than SUFFIX_CACHE_MIN_LEN are cheaper to walk than to
+ * look up and are not cached.
+ */
+
+#define SUFFIX_CACHE_INIT   (1 << 16)
+#define SUFFIX_CACHE_MIN_LEN    8
+#define SUFFIX_HASH_MUL     0x100000001b3ull
+
+typedef struct SuffixEntry {
+    uint64_t hash;
+    const char *str;    // the suffix letters
+    uint32_t len;       // 0: empty slot
+    int32_t parts;
+}suffixEntry;
+
+typedef struct SuffixCache {
+    vector<suffixEntry> slot;
+    size_t used;
+    size_t lookups;
+    size_t hits;
+}suffixCache;
+
+void cacheInit(suffixCache *cache)
+{
+    suffixEntry empty = {0, NULL, 0, 0};
+    cache->slot.assign(SUFFIX_CACHE_INIT, empty);
+    cache->used = 0;
+    cache->lookups = 0;
+    cache->hits = 0;
+}
+
+// forget every suffix, the counters stay
+void cacheClear(suffixCache *cache)
+{
+    suffixEntry empty = {0, NULL, 0, 0};
+    cache->slot.assign(cache->slot.size(), empty);
+    cache->used = 0;
+}
+
+void cacheDestroy(suffixCache *cache)
+{
+    vector<suffixEntry>().swap(cache->slot);
+    cache->used = 0;
+}
+
+// hash of every suffix of str[start..end], hash[p] covers str[p..end]
+void suffixHashes(const char *str, int start, int end, uint64_t *hash)
+{
+    uint64_t h = 0;
+    for (int p = end; p >= start; p--) {
+        h = (h ^ (unsigned char)str[p]) * SUFFIX_HASH_MUL;
+        hash[p] = h;
+    }
+}
+
+bool cacheFind(suffixCache *cache, uint64_t hash, const char *str, uint32_t len, int &parts)
+{
+    size_t mask = cache->slot.size() - 1;
+    cache->lookups++;
+    for (size_t i = (hash ^ (hash >> 29)) & mask; cache->slot[i].len != 0; i = (i + 1) & mask) {
+        if (cache->slot[i].hash == hash && cache->slot[i].len == len && memcmp(cache->slot[i].str, str, len) == 0) {
+            cache->hits++;
+            parts = cache->slot[i].parts;
+            return true;
+        }
+    }
+    return false;
+}
+
+void cacheStore(suffixCache *cache, uint64_t hash, const char *str, uint32_t len, int parts)
+{
+    // keep the table at most half full
+    if (2 * (cache->used + 1) > cache->slot.size()) {
+        vector<suffixEntry> old;
+        old.swap(cache->slot);
+        suffixEntry empty = {0, NULL, 0, 0};
+        cache->slot.assign(old.size() * 2, empty);
+        cache->used = 0;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].len != 0)
+                cacheStore(cache, old[i].hash, old[i].str, old[i].len, old[i].parts);
+        }
+    }
+    size_t mask = cache->slot.size() - 1;
+    size_t i = (hash ^ (hash >> 29)) & mask;
+    while (cache->slot[i].len != 0) {
+        if (cache->slot[i].hash == hash && cache->slot[i].len == len && memcmp(cache->slot[i].str, str, len) == 0)
+            return;
+        i = (i + 1) & mask;
+    }
+    cache->slot[i].hash = hash;
+    cache->slot[i].str = str;
+    cache->slot[i].len = len;
+    cache->slot[i].parts = parts;
+    cache->used++;
+}
+
+/**
+ * count of subwords of str[p..end], 0 when it cannot be split
+ * parts[] memoizes the positions of this word (-1: not solved yet),
+ * the cache the suffixes of all words
+ * CONCAT_TIMED_OUT when the budget ran out, nothing is memoized then
+ */
+template <class T>
+int suffixParts(T *node, const char *str, int p, int end, int *parts, const uint64_t *hash, suffixCache *cache, int64_t *budget)
+{
+    if (parts[p] >= 0)
+        return parts[p];
+
+    int cnt = 0;
+    bool cached = cache != NULL && end - p + 1 >= SUFFIX_CACHE_MIN_LEN;
+    if (cached && cacheFind(cache, hash[p], str + p, end - p + 1, cnt)) {
+        parts[p] = cnt;
+        return cnt;
+    }
+    auto subnode = trieRoot(node);
+    for (int i = p; i <= end; i++) {
+        if (budget != NULL && --*budget < 0)
+            return CONCAT_TIMED_OUT;
+        subnode = trieNext(node, subnode, str[i] - 'a');
+        if (!subnode)
+            break;
+        if (trieIsLeaf(node, subnode)) {
+            if (i == end) {
+                cnt = 1;
+                break;
+            }
+            int rest = suffixParts(node, str, i+1, end, parts, hash, cache, budget);
+            if (rest == CONCAT_TIMED_OUT)
+                return CONCAT_TIMED_OUT;
+            if (rest > 0) {
+                cnt = 1 + rest;
+                break;
+            }
+        }
+    }
+    parts[p] = cnt;
+    if (cached)
+        cacheStore(cache, hash[p], str + p, end - p + 1, cnt);
+    return cnt;
+}
+
+/**
+ * decide a word whether are made of other words, by dynamic programming
+ * return count of subwords, same result as concatWordRecursive()
+ * Same search as the recursion, shortest word first, but every position
+ * is solved at most once (memoized), so each start position is walked down
+ * the Trie once: O(L^2) Trie steps in the worst case. Only positions right
+ * after a word end are ever solved.
+ * cache (optional) shares the suffix results across words.
+ * The memoized recursion nests once per subword, so words longer than
+ * DP_DEEP_LEN are solved from the end first: each position then only
+ * looks at solved ones and the stack stays flat, whatever the length.
+ * budget (optional): remaining steps, CONCAT_TIMED_OUT when it runs out
+ * breaks (optional): gets the end position of every subword, in order,
+ * room for end - start + 1 entries; the search is replayed along the
+ * solved positions, so it costs one more walk per subword
+ * Words longer than DP_LOCAL_LEN use tables kept per thread, grown as
+ * needed, so the search does not allocate once they are large enough.
+ */
+#define DP_LOCAL_LEN    256
+#define DP_DEEP_LEN     4096
+
+template <class T>
+int concatWord(T *node, const char *str, int start, int end, bool &result, suffixCache *cache = NULL, int64_t *budget = NULL, int *breaks = NULL)
+{
+    result = false;
+
+    // validate input
+    if (start > end) {
+        return 0;
+    }
+    int localParts[DP_LOCAL_LEN];
+    uint64_t localHash[DP_LOCAL_LEN];
+    static thread_local vector<int> scratchParts;
+    static thread_local vector<uint64_t> scratchHash;
+    int *parts = localParts;
+    uint64_t *hash = localHash;
+    int len = end - start + 1;
+    if (len > DP_LOCAL_LEN) {
+        if (scratchParts.size() < (size_t)len) {
+            scratchParts.resize(len);
+            scratchHash.resize(len);
+        }
+        parts = &scratchParts[0];
+        hash = &scratchHash[0];
+    }
+    for (int i = 0; i < len; i++)
+        parts[i] = -1;
+    // index both by position
+    parts -= start;
+    hash -= start;
+    if (cache != NULL)
+        suffixHashes(str, start, end, hash);
+
+    int cntWords = 0;
+    if (len > DP_DEEP_LEN) {
+        for (int p = end; p > start && cntWords != CONCAT_TIMED_OUT; p--)
+            cntWords = suffixParts(node, str, p, end, parts, hash, cache, budget);
+    }
+    if (cntWords != CONCAT_TIMED_OUT)
+        cntWords = suffixParts(node, str, start, end, parts, hash, cache, budget);
+
+    // take the first word end whose rest splits, as suffixParts() did
+    for (int p = start, k = 0; breaks != NULL && cntWords > 0 && k < cntWords; ) {
+        auto subnode = trieRoot(node);
+        int i;
+        for (i = p; i <= end; i++) {
+            subnode = trieNext(node, subnode, str[i] - 'a');
+            if (!subnode)
+                break;
+            if (trieIsLeaf(node, subnode) &&
+                (i == end || suffixParts(node, str, i+1, end, parts, hash, cache, (int64_t *)NULL) > 0))
+                break;
+        }
+        breaks[k++] = i;
+        p = i + 1;
+    }
+
+    result = cntWords > 0;
+    return cntWords;
+}
+
+/**
+ * fewest and most subwords of str[start..end], over all its segmentations
+ * into two or more dictionary words, 0 and 0 when there is none
+ * returns true when there is one
+ * One pass from the end: every position p gets the fewest and the most
+ * subwords str[p..end] splits into, from the Trie matches starting at p
+ * and the positions after them, O(L^2) Trie steps at most, and no
+ * recursion. The tables are kept per thread, like concatWord() does.
+ * minEnds, maxEnds (optional): get the subword ends of both segmentations,
+ * room for end - start + 1 entries; ties go to the shorter first word
+ */
+template <class T>
+bool wordPartsRange(T *node, const char *str, int start, int end, int &minParts, int &maxParts, int *minEnds = NULL, int *maxEnds = NULL)
+{
+    minParts = 0;
+    maxParts = 0;
+    if (start > end)
+        return false;
+    static thread_local vector<int> scratch;
+    size_t len = end - start + 2;
+    if (scratch.size() < 4 * len)
+        scratch.resize(4 * len);
+    // lo[p], hi[p]: fewest and most subwords of str[p..end], 0: no split
+    // loEnd[p], hiEnd[p]: end of the first subword of each; all by position
+    int *lo = &scratch[0] - start;
+    int *hi = lo + len;
+    int *loEnd = hi + len;
+    int *hiEnd = loEnd + len;
+
+    for (int p = end; p >= start; p--) {
+        lo[p] = 0;
+        hi[p] = 0;
+        auto subnode = trieRoot(node);
+        for (int i = p; i <= end; i++) {
+            subnode = trieNext(node, subnode, str[i] - 'a');
+            if (!subnode)
+                break;
+            if (!trieIsLeaf(node, subnode))
+                continue;
+            int restLo = 0, restHi = 0;
+            if (i < end) {
+                if (lo[i+1] == 0)
+                    continue;
+                restLo = lo[i+1];
+                restHi = hi[i+1];
+            } else if (p == start) {
+                // the word itself is no segmentation
+                break;
+            }
+            if (lo[p] == 0 || restLo + 1 < lo[p]) {
+                lo[p] = restLo + 1;
+                loEnd[p] = i;
+            }
+            if (restHi + 1 > hi[p]) {
+                hi[p] = restHi + 1;
+                hiEnd[p] = i;
+            }
+        }
+    }
+    minParts = lo[start];
+    maxParts = hi[start];
+    for (int p = start, k = 0; minEnds != NULL && k < minParts; k++) {
+        minEnds[k] = loEnd[p];
+        p = loEnd[p] + 1;
+    }
+    for (int p = start, k = 0; maxEnds != NULL && k < maxParts; k++) {
+        maxEnds[k] = hiEnd[p];
+        p = hiEnd[p] + 1;
+    }
+    return minParts > 0;
+}
+
+// the other layouts have no Aho-Corasick links: the same answer, the
+// fewest subwords, from wordPartsRange()
+template <class T>
+int acConcatWord(T *node, const char *str, int start, int end, bool &result, int *ends = NULL)
+{
+    int minParts, maxParts;
+    result = wordPartsRange(node, str, start, end, minParts, maxParts, ends);
+    if (result || start > end)
+        return minParts;
+    // a word that does not split
+    auto subnode = trieRoot(node);
+    for (int i = start; subnode && i <= end; i++)
+        subnode = trieNext(node, subnode, str[i] - 'a');
+    result = subnode && trieIsLeaf(node, subnode);
+    if (result && ends != NULL)
+        ends[0] = end;
+    return result;
+}
+
+#define SPLIT_COUNT_MAX UINT64_MAX
+
+/**
+ * number of distinct segmentations of str[start..end] into two or more
+ * dictionary words, saturating at SPLIT_COUNT_MAX
+ * The same pass from the end as wordPartsRange(): ways[p], the number of
+ * splits of str[p..end], is the sum of ways[i+1] over the Trie matches
+ * str[p..i], so the splits are counted, never listed, in O(L^2) Trie
+ * steps even when there are exponentially many.
+ */
+template <class T>
+uint64_t wordSplitCount(T *node, const char *str, int start, int end)
+{
+    if (start > end)
+        return 0;
+    static thread_local vector<uint64_t> scratch;
+    size_t len = end - start + 2;
+    if (scratch.size() < len)
+        scratch.resize(len);
+    // ways[p]: splits of str[p..end] into one or more words, ways[end+1]: 1
+    uint64_t *ways = &scratch[0] - start;
+    ways[end+1] = 1;
+
+    for (int p = end; p >= start; p--) {
+        uint64_t sum = 0;
+        auto subnode = trieRoot(node);
+        for (int i = p; i <= end; i++) {
+            subnode = trieNext(node, subnode, str[i] - 'a');
+            if (!subnode)
+                break;
+            // the word itself is no segmentation
+            if (!trieIsLeaf(node, subnode) || (p == start && i == end))
+                continue;
+            uint64_t rest = ways[i+1];
+            sum = sum > SPLIT_COUNT_MAX - rest ? SPLIT_COUNT_MAX : sum + rest;
+        }
+        ways[p] = sum;
+    }
+    return ways[start];
+}
+
+// a word of the input buffer, NUL-terminated in place
+typedef struct WordRef {
+    const char *str;
+    int len;
+}wordref;
+
+/**
+ * Word store
+ * All words of the input in one array of references into the mapped file,
+ * added in input order and then ordered longest first by a stable counting
+ * sort on the length: no tree, no list node and no string per word, and
+ * the search reads the words in one sequential pass.
+ */
+typedef struct WordStore {
+    vector<wordref> word;
+    int maxLen;
+}wordStore;
+
+void storeInit(wordStore *store)
+{
+    store->word.clear();
+    store->maxLen = 0;
+}
+
+inline void storeAdd(wordStore *store, const char *str, int len)
+{
+    wordref word = {str, len};
+    store->word.push_back(word);
+    if (len > store->maxLen)
+        store->maxLen = len;
+}
+
+// order the words longest first, in input order within a length
+void storeSortByLength(wordStore *store)
+{
+    // first[len]: where the words of length len start, after all longer ones
+    vector<size_t> first(store->maxLen + 2, 0);
+    for (size_t i = 0; i < store->word.size(); i++)
+        first[store->word[i].len]++;
+    size_t pos = 0;
+    for (int len = store->maxLen; len >= 0; len--) {
+        size_t cnt = first[len];
+        first[len] = pos;
+        pos += cnt;
+    }
+    vector<wordref> sorted(store->word.size());
+    for (size_t i = 0; i < store->word.size(); i++)
+        sorted[first[store->word[i].len]++] = store->word[i];
+    store->word.swap(sorted);
+}
+
+static bool lessWord(const char *a, const char *b)
+{
+    return strcmp(a, b) < 0;
+}
+
+// collect all words in strcmp order, for the layouts built from sorted input
+void sortedWords(const wordStore *store, vector<const char*> &sorted)
+{
+    for (size_t i = 0; i < store->word.size(); i++)
+        sorted.push_back(store->word[i].str);
+    sort(sorted.begin(), sorted.end(), lessWord);
+}
+
+// Trie layouts the compound word search can run on
+enum TrieLayout {
+    LAYOUT_POINTER,
+    LAYOUT_COMPACT,
+    LAYOUT_BITMAP,
+    LAYOUT_DOUBLE_ARRAY,
+    LAYOUT_DAWG
+};
+
+static const char *layoutName[] = {
+    "pointer", "compact", "bitmap", "double-array", "dawg"
+};
+
+/**
+ * Mapped input file
+ * The input is mapped private and writable, so lines can be cut in place:
+ * copy-on-write keeps the file untouched. One zero page is mapped past the
+ * end, so the last line is NUL-terminated even without a newline.
+ */
+typedef struct MappedFile {
+    char *data;
+    size_t size;        // file size
+    size_t mapped;      // bytes mapped, with the zero page
+}mappedFile;
+
+/**
+ * read what is not a regular file (a pipe, a FIFO, a /proc file) into
+ * zeroed anonymous memory, doubled as it fills, keeping a zero byte at
+ * the end like a mapped file
+ */
+static bool readStream(int fd, mappedFile *file)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapped = 256 * page;
+    char *base = (char *)mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return false;
+    size_t size = 0;
+    for (;;) {
+        if (size + 1 == mapped) {
+            char *grown = (char *)mmap(NULL, 2 * mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (grown == MAP_FAILED) {
+                munmap(base, mapped);
+                return false;
+            }
+            memcpy(grown, base, size);
+            munmap(base, mapped);
+            base = grown;
+            mapped *= 2;
+        }
+        ssize_t n = read(fd, base + size, mapped - 1 - size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            munmap(base, mapped);
+            return false;
+        }
+        if (n == 0)
+            break;
+        size += n;
+    }
+    file->data = base;
+    file->size = size;
+    file->mapped = mapped;
+    return true;
+}
+
+// map a file, returns false when it cannot be opened
+bool mapFile(const char *filename, mappedFile *file)
+{
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+    // st_size means nothing for a pipe, and /proc files report 0
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        bool ok = readStream(fd, file);
+        close(fd);
+        return ok;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    file->size = (size_t)st.st_size;
+    file->mapped = (file->size / page + 1) * page;
+    // reserve zero pages, then map the file over the front of them
+    void *base = mmap(NULL, file->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (file->size > 0 &&
+        mmap(base, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, file->mapped);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    madvise(base, file->size, MADV_SEQUENTIAL);
+    file->data = (char *)base;
+    return true;
+}
+
+void unmapFile(mappedFile *file)
+{
+    if (file->data != NULL)
+        munmap(file->data, file->mapped);
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+}
+
+/**
+ * Trie image
+ * A bitmap Trie or DAWG saved as is: a header and the node array. Nodes
+ * refer to their children by index, not by pointer, so the image works at
+ * any address: it is mapped read-only and searched in place, with nothing
+ * to parse or rebuild, and every process mapping it shares the same
+ * page cache. Loading costs the same for any dictionary size.
+ * An image is trusted: the header, the size and the root are checked on
+ * load, the other nodes only with a full check (imageMap() verify, -V),
+ * which reads every node once; a corrupted node can crash the search.
+ */
+
+#define TRIE_IMAGE_MAGIC    "WORDTRIE"
+#define TRIE_IMAGE_VERSION  1
+
+typedef struct TrieImageHeader {
+    char magic[8];          // TRIE_IMAGE_MAGIC
+    uint32_t version;       // TRIE_IMAGE_VERSION
+    uint32_t layout;        // LAYOUT_BITMAP or LAYOUT_DAWG
+    uint64_t nodes;         // nodes following the header
+    uint64_t words;         // words of the dictionary
+}trieImageHeader;
+
+typedef struct TrieImage {
+    const trieImageHeader *header;
+    const bnode *node;      // node 0 is the root
+    size_t mapped;
+}trieImage;
+
+// write the nodes of t as an image, returns false on a write error
+bool imageWrite(const btrie *t, TrieLayout layout, size_t words, const char *filename)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return false;
+    trieImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRIE_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = TRIE_IMAGE_VERSION;
+    header.layout = layout;
+    header.nodes = t->node.size();
+    header.words = words;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(&t->node[0], sizeof(bnode), t->node.size(), fp) == t->node.size();
+    return fclose(fp) == 0 && ok;
+}
+
+// whether the children of node n lie inside the node array, never the root
+static inline bool imageNodeValid(const bnode &n, uint64_t nodes)
+{
+    uint32_t children = n.mask & BTRIE_MASK;
+    if ((n.mask & ~(BTRIE_MASK | BTRIE_LEAF)) != 0)
+        return false;
+    return children == 0 || (n.child >= 1 && n.child + (uint64_t)__builtin_popcount(children) <= nodes);
+}
+
+/**
+ * map an image read-only, returns false when it is missing, not an image
+ * or fails a check
+ * verify: check every node, not only the root
+ */
+bool imageMap(const char *filename, trieImage *image, bool verify = false)
+{
+    image->header = NULL;
+    image->node = NULL;
+    image->mapped = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(trieImageHeader) + sizeof(bnode)) {
+        close(fd);
+        return false;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    const trieImageHeader *header = (const trieImageHeader *)base;
+    if (memcmp(header->magic, TRIE_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRIE_IMAGE_VERSION ||
+        (header->layout != LAYOUT_BITMAP && header->layout != LAYOUT_DAWG) ||
+        header->nodes == 0 ||
+        header->nodes != ((size_t)st.st_size - sizeof(trieImageHeader)) / sizeof(bnode) ||
+        header->nodes > UINT32_MAX) {
+        munmap(base, st.st_size);
+        return false;
+    }
+    const bnode *node = (const bnode *)(header + 1);
+    for (uint64_t i = 0; i < (verify ? header->nodes : 1); i++) {
+        if (!imageNodeValid(node[i], header->nodes)) {
+            munmap(base, st.st_size);
+            return false;
+        }
+    }
+    image->header = header;
+    image->node = node;
+    image->mapped = st.st_size;
+    return true;
+}
+
+void imageUnmap(trieImage *image)
+{
+    if (image->header != NULL)
+        munmap((void *)image->header, image->mapped);
+    image->header = NULL;
+    image->node = NULL;
+    image->mapped = 0;
+}
+
+// walk primitives for the segmentation engine
+inline const bnode* trieRoot(const trieImage *t)
+{
+    return &t->node[0];
+}
+
+inline const bnode* trieNext(const trieImage *t, const bnode *cur, int ch)
+{
+    uint32_t next = bnodeChild(*cur, ch);
+    return next == 0 ? NULL : &t->node[next];
+}
+
+inline bool trieIsLeaf(const trieImage *t, const bnode *cur)
+{
+    return bnodeIsLeaf(*cur);
+}
+
+/**
+ * split a buffer into words in place
+ * every run of spaces, tabs, '\r' and '\n' separates two words, as reading
+ * them with an istream did; each separator becomes '\0' and addWord(str,
+ * len) is called for each word. buf[size] must be '\0'.
+ * lines: split at '\n' only (and cut a '\r' before it) and pass the empty
+ * lines too, for answers that must line up with the input lines
+ * Separators are found 16 bytes at a time with SSE2.
+ */
+template <class F>
+int splitLines(char *buf, size_t size, F addWord, bool lines = false)
+{
+    int cntWords = 0;
+    size_t lineStart = 0;
+    size_t i = 0;
+
+    // cut the word ending at pos
+    #define END_LINE(pos) do { \
+        size_t end_ = (pos); \
+        buf[end_] = '\0'; \
+        if (lines && end_ > lineStart && buf[end_-1] == '\r') \
+            buf[--end_] = '\0'; \
+        if (lines || end_ > lineStart) { \
+            addWord(buf + lineStart, (int)(end_ - lineStart)); \
+            cntWords++; \
+        } \
+        lineStart = (pos) + 1; \
+    } while (0)
+    #define IS_SEPARATOR(c) ((c) == '\n' || (!lines && ((c) == ' ' || (c) == '\t' || (c) == '\r')))
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(lines ? '\n' : ' ');
+    const __m128i tab = _mm_set1_epi8(lines ? '\n' : '\t');
+    const __m128i cr = _mm_set1_epi8(lines ? '\n' : '\r');
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, space)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, cr)));
+        unsigned bits = _mm_movemask_epi8(hit);
+        while (bits != 0) {
+            END_LINE(i + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+#endif
+    for (; i < size; i++) {
+        if (IS_SEPARATOR(buf[i]))
+            END_LINE(i);
+    }
+    // last line without a newline
+    if (lineStart < size)
+        END_LINE(size);
+
+    #undef IS_SEPARATOR
+    #undef END_LINE
+    return cntWords;
+}
+
+/**
+ * Parallel build
+ * Subtrees below different two-letter prefixes share no node, so the Trie
+ * can be built by prefix: the root and its children are made first, then
+ * threads take the prefixes from an atomic cursor, biggest first, and each
+ * builds the subtree of a prefix into its own arena, without locking. The
+ * subtrees are hooked under their prefix node, and the thread arenas are
+ * merged into the pool at the end. Same Trie as the serial build.
+ */
+
+#define BUILD_PREFIXES  (CHAR_SIZE * CHAR_SIZE)
+
+typedef struct BuildShared {
+    trie *root;
+    const vector<wordref> *words;           // grouped by prefix
+    const vector<size_t> *first;            // first word of each prefix, and the end
+    const vector<int> *order;               // prefixes, biggest first
+    size_t next;                            // next prefix of order
+}buildShared;
+
+typedef struct BuildWorker {
+    buildShared *shared;
+    arena pool;                             // nodes of this thread
+}buildWorker;
+
+// two-letter prefix of a word, -1: too short
+inline int buildPrefix(const wordref &word)
+{
+    if (word.len < 2)
+        return -1;
+    return (word.str[0] - 'a') * CHAR_SIZE + (word.str[1] - 'a');
+}
+
+void* buildThread(void *arg)
+{
+    buildWorker *worker = (buildWorker *)arg;
+    buildShared *shared = worker->shared;
+    const vector<size_t> &first = *shared->first;
+    for (;;) {
+        size_t k = __atomic_fetch_add(&shared->next, 1, __ATOMIC_RELAXED);
+        if (k >= shared->order->size())
+            break;
+        int prefix = (*shared->order)[k];
+        trie *subroot = create(&worker->pool);
+        for (size_t i = first[prefix]; i < first[prefix + 1]; i++)
+            insertWord(subroot, (*shared->words)[i].str + 2, &worker->pool);
+        shared->root->character[prefix / CHAR_SIZE]->character[prefix % CHAR_SIZE] = subroot;
+    }
+    return NULL;
+}
+
+/**
+ * build the Trie of words under root on threads, the words are 'a'-'z'
+ * words shorter than two letters are inserted serially
+ */
+void buildTrie(trie *root, arena *pool, const vector<wordref> &words, int threads)
+{
+    // group the words by prefix, counting sort
+    vector<size_t> first(BUILD_PREFIXES + 1, 0);
+    for (size_t i = 0; i < words.size(); i++) {
+        int prefix = buildPrefix(words[i]);
+        if (prefix < 0) {
+            insertWord(root, words[i].str, pool);
+            continue;
+        }
+        first[prefix + 1]++;
+        // the prefix node the subtree hangs from
+        trie* &edge = root->character[prefix / CHAR_SIZE];
+        if (edge == NULL)
+            edge = create(pool);
+    }
+    for (int k = 0; k < BUILD_PREFIXES; k++)
+        first[k + 1] += first[k];
+    vector<wordref> grouped(first[BUILD_PREFIXES]);
+    vector<size_t> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < words.size(); i++) {
+        int prefix = buildPrefix(words[i]);
+        if (prefix >= 0)
+            grouped[fill[prefix]++] = words[i];
+    }
+
+    vector<int> order;
+    for (int k = 0; k < BUILD_PREFIXES; k++) {
+        if (first[k + 1] > first[k])
+            order.push_back(k);
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        return first[a + 1] - first[a] > first[b + 1] - first[b];
+    });
+
+    buildShared shared = {root, &grouped, &first, &order, 0};
+    vector<buildWorker> worker(threads);
+    vector<pthread_t> tid(threads);
+    for (int i = 0; i < threads; i++) {
+        worker[i].shared = &shared;
+        arenaInit(&worker[i].pool);
+    }
+    // the calling thread is worker 0; when a thread cannot be started, the
+    // ones running take its prefixes from the shared cursor
+    int started = 1;
+    while (started < threads && pthread_create(&tid[started], NULL, buildThread, &worker[started]) == 0)
+        started++;
+    buildThread(&worker[0]);
+    for (int i = 1; i < started; i++)
+        pthread_join(tid[i], NULL);
+    for (int i = 0; i < threads; i++)
+        arenaMerge(pool, &worker[i].pool);
+}
+
+// whether str[0..len-1] is a non-empty run of 'a'-'z', the only letters of the Trie
+static inline bool wordValid(const char *str, int len)
+{
+    if (len == 0)
+        return false;
+    for (int i = 0; i < len; i++) {
+        if (str[i] < 'a' || str[i] > 'z')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * read words from input file, without a Trie, see ReadWordFile()
+ * assume input lowercase words, nospaces, on word perline
+ * the file is mapped and split line by line in place: no copy and no
+ * allocation per word. The words point into input, keep it mapped while
+ * they are used. A word with anything but 'a'-'z' in it is skipped, as
+ * every layout indexes its children by letter.
+ * skipped: counts the words skipped, when not NULL
+ * returns the number of words kept, -1 when the file cannot be read
+ */
+int ReadWordList(const char *filename, mappedFile *input, wordStore *store, int *skipped = NULL)
+{
+    if (!mapFile(filename, input))
+        return -1;
+    int cntSkipped = 0;
+    int cntWords = splitLines(input->data, input->size, [&](const char *str, int len) {
+        if (wordValid(str, len))
+            storeAdd(store, str, len);
+        else
+            cntSkipped++;
+    });
+    if (skipped != NULL)
+        *skipped = cntSkipped;
+    return cntWords - cntSkipped;
+}
+
+/**
+ * build the pointer Trie of the words read by ReadWordList()
+ * one thread inserts them in file order, more build it by prefix with
+ * buildTrie()
+ */
+void insertWords(trie* &root, arena *pool, const wordStore *store, int threads = 1)
+{
+    root = create(pool);
+    if (threads > 1) {
+        buildTrie(root, pool, store->word, threads);
+        return;
+    }
+    for (size_t i = 0; i < store->word.size(); i++)
+        insertWord(root, store->word[i].str, pool);
+}
+
+/**
+ * read words from input file
+ * into trie data structure
+ * ReadWordList() and insertWords() in one call; the run times them as
+ * the load and build phases
+ * returns the number of words, -1 when the file cannot be read
+ */
+int ReadWordFile(const char *filename, mappedFile *input, trie* &root, arena *pool, wordStore *store, int threads = 1)
+{
+    root = NULL;
+    int cntWords = ReadWordList(filename, input, store);
+    if (cntWords < 0)
+        return -1;
+    insertWords(root, pool, store, threads);
+    return cntWords;
+}
+
+/**
+ * Output buffer
+ * Found words are collected into one large buffer that goes out with a
+ * single write() whenever it fills up, instead of an ofstream flush per
+ * word. With positions on, a word is written as "offset length" of its
+ * place in the input file instead of its letters. A failed write() is
+ * remembered and reported by outClose(), interrupted ones are retried.
+ */
+
+#define OUT_BUFFER_SIZE     (1 << 20)
+
+typedef struct OutBuffer {
+    int fd;
+    char *buf;
+    size_t used;
+    const char *input;  // start of the input buffer, NULL: write the words
+    size_t flushes;     // write() calls
+    bool failed;        // a write() failed, output is lost
+}outBuffer;
+
+// create the output file, "-" is stdout, returns false when it cannot be created
+bool outOpen(outBuffer *out, const char *filename, const char *input)
+{
+    if (strcmp(filename, "-") == 0)
+        out->fd = dup(STDOUT_FILENO);
+    else
+        out->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    out->buf = (char *)heapAlloc(OUT_BUFFER_SIZE);
+    out->used = 0;
+    out->input = input;
+    out->flushes = 0;
+    out->failed = false;
+    return out->fd >= 0;
+}
+
+// write all of str, the failed flag is set when that is not possible
+static void outWriteAll(outBuffer *out, const char *str, size_t len)
+{
+    size_t done = 0;
+    while (done < len && !out->failed) {
+        ssize_t n = write(out->fd, str + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            out->failed = true;
+        else
+            done += n;
+    }
+}
+
+void outFlush(outBuffer *out)
+{
+    outWriteAll(out, out->buf, out->used);
+    out->used = 0;
+    out->flushes++;
+}
+
+void outWrite(outBuffer *out, const char *str, size_t len)
+{
+    if (out->used + len > OUT_BUFFER_SIZE)
+        outFlush(out);
+    if (len > OUT_BUFFER_SIZE) {
+        // too large to buffer
+        outWriteAll(out, str, len);
+        return;
+    }
+    memcpy(out->buf + out->used, str, len);
+    out->used += len;
+}
+
+// append a decimal number
+void outNumber(outBuffer *out, size_t num)
+{
+    char digits[24];
+    int i = sizeof(digits);
+    do {
+        digits[--i] = '0' + num % 10;
+        num /= 10;
+    } while (num != 0);
+    outWrite(out, digits + i, sizeof(digits) - i);
+}
+
+// append a tab and the subwords of word separated by '|', ends[] from concatWord()
+void outSubwords(outBuffer *out, const wordref &word, const int *ends, int cnt)
+{
+    int start = 0;
+    for (int k = 0; k < cnt; k++) {
+        outWrite(out, k == 0 ? "\t" : "|", 1);
+        outWrite(out, word.str + start, ends[k] + 1 - start);
+        start = ends[k] + 1;
+    }
+}
+
+// append a word, or its offset and length with positions on
+void outWordName(outBuffer *out, const wordref &word)
+{
+    if (out->input != NULL) {
+        outNumber(out, word.str - out->input);
+        outWrite(out, " ", 1);
+        outNumber(out, word.len);
+    } else {
+        outWrite(out, word.str, word.len);
+    }
+}
+
+// write what is left and close, returns false when any output was lost
+bool outClose(outBuffer *out)
+{
+    if (out->used > 0)
+        outFlush(out);
+    if (out->fd >= 0 && close(out->fd) != 0)
+        out->failed = true;
+    free(out->buf);
+    out->fd = -1;
+    out->buf = NULL;
+    return !out->failed;
+}
+
+/**
+ * Phase timing
+ * Wall time (steady_clock), CPU time of the whole process and of the
+ * calling thread, and heap allocations (operator new and the malloc()
+ * of arena slabs, output buffers and the recursion, all through
+ * heapAlloc()), summed per phase of the run.
+ * The search threads also report their own CPU time, and the summary ends
+ * with the peak RSS. A phase may be entered more than once.
+ */
+
+enum Phase {
+    PHASE_LOAD,         // read and split the word file
+    PHASE_BUILD,        // build the selected Trie layout
+    PHASE_SORT,         // order the words longest first
+    PHASE_SEARCH,       // find the compound words
+    PHASE_OUTPUT,       // write the found words
+    PHASE_TEARDOWN,     // release everything
+    PHASE_COUNT
+};
+
+static const char *phaseName[PHASE_COUNT] = {
+    "load", "build", "sort", "search", "output", "teardown"
+};
+
+/**
+ * kept out of line: once inlined, GCC sees malloc() paired with operator
+ * delete, or operator new paired with free(), and warns of a mismatch
+ */
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    void *p = heapAlloc(size ? size : 1);
+    if (p == NULL)
+        throw bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+typedef struct PhaseTimer {
+    double wall[PHASE_COUNT];
+    double cpu[PHASE_COUNT];        // process, all threads
+    double threadCpu[PHASE_COUNT];  // calling thread
+    size_t allocs[PHASE_COUNT];
+    vector<double> searchCpu;       // CPU time of each search thread
+    // phase in progress
+    int current;
+    chrono::steady_clock::time_point wallStart;
+    double cpuStart;
+    double threadCpuStart;
+    size_t allocStart;
+}phaseTimer;
+
+static double cpuSeconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void timerInit(phaseTimer *timer)
+{
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        timer->wall[i] = 0;
+        timer->cpu[i] = 0;
+        timer->threadCpu[i] = 0;
+        timer->allocs[i] = 0;
+    }
+    timer->current = -1;
+}
+
+void phaseBegin(phaseTimer *timer, int phase)
+{
+    timer->current = phase;
+    timer->allocStart = __atomic_load_n(&cntAllocs, __ATOMIC_RELAXED);
+    timer->cpuStart = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    timer->threadCpuStart = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+    timer->wallStart = chrono::steady_clock::now();
+}
+
+void phaseEnd(phaseTimer *timer)
+{
+    int phase = timer->current;
+    if (phase < 0)
+        return;
+    chrono::duration<double> wall = chrono::steady_clock::now() - timer->wallStart;
+    timer->wall[phase] += wall.count();
+    timer->cpu[phase] += cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - timer->cpuStart;
+    timer->threadCpu[phase] += cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - timer->threadCpuStart;
+    timer->allocs[phase] += __atomic_load_n(&cntAllocs, __ATOMIC_RELAXED) - timer->allocStart;
+    timer->current = -1;
+}
+
+// peak resident set size so far, in KB
+long peakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// human readable summary
+void timerReport(phaseTimer *timer, FILE *fp)
+{
+    double wall = 0, cpu = 0;
+    size_t allocs = 0;
+    fprintf(fp, "%-10s %10s %10s %12s %10s\n", "phase", "wall(s)", "cpu(s)", "thread(s)", "allocs");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(fp, "%-10s %10.6f %10.6f %12.6f %10zu\n", phaseName[i],
+               timer->wall[i], timer->cpu[i], timer->threadCpu[i], timer->allocs[i]);
+        wall += timer->wall[i];
+        cpu += timer->cpu[i];
+        allocs += timer->allocs[i];
+    }
+    fprintf(fp, "%-10s %10.6f %10.6f %12s %10zu\n", "total", wall, cpu, "", allocs);
+    for (size_t i = 0; i < timer->searchCpu.size(); i++)
+        fprintf(fp, "search thread %zu: %.6f s cpu\n", i, timer->searchCpu[i]);
+    fprintf(fp, "Peak RSS: %ld KB\n", peakRss());
+    fflush(fp);
+}
+
+// write a JSON string literal
+static void jsonString(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', fp);
+        if ((unsigned char)*str >= 0x20)
+            fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+// machine readable report, returns false when the file cannot be written
+bool timerWriteJson(phaseTimer *timer, const char *filename, const char *input,
+                    const char *layout, int threads, int cntWords, int foundWords, size_t arenaSlabs)
+{
+    FILE *fp = fopen(filename, "w");
+    if (fp == NULL)
+        return false;
+    double wall = 0;
+    size_t allocs = 0;
+    fprintf(fp, "{\n  \"input\": ");
+    jsonString(fp, input);
+    fprintf(fp, ",\n  \"layout\": \"%s\",\n  \"threads\": %d,\n", layout, threads);
+    fprintf(fp, "  \"words\": %d,\n  \"found\": %d,\n  \"phases\": {\n", cntWords, foundWords);
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(fp, "    \"%s\": {\"wall\": %.9f, \"cpu\": %.9f, \"thread_cpu\": %.9f, \"allocs\": %zu}%s\n",
+                phaseName[i], timer->wall[i], timer->cpu[i], timer->threadCpu[i], timer->allocs[i],
+                i + 1 < PHASE_COUNT ? "," : "");
+        wall += timer->wall[i];
+        allocs += timer->allocs[i];
+    }
+    fprintf(fp, "  },\n  \"search_thread_cpu\": [");
+    for (size_t i = 0; i < timer->searchCpu.size(); i++)
+        fprintf(fp, "%s%.9f", i ? ", " : "", timer->searchCpu[i]);
+    fprintf(fp, "],\n  \"total_wall\": %.9f,\n  \"allocs\": %zu,\n  \"arena_slabs\": %zu,\n  \"peak_rss_kb\": %ld\n}\n",
+            wall, allocs, arenaSlabs, peakRss());
+    fclose(fp);
+    return true;
+}
+
+/**
+ * Parallel search
+ * Each word is checked on its own and the Trie is read-only by now, so the
+ * words are handed out to the threads in chunks from a shared atomic
+ * cursor: a thread that runs out of work grabs the next chunk, which
+ * balances uneven words like work stealing does. Every result lands in
+ * the slot of its word and the output is written in the serial order
+ * afterwards, the same for any number of threads.
+ */
+
+#define SEARCH_CHUNK    256
+
+// what the search finds for every word
+enum SearchMode {
+    SEARCH_FIRST,       // the first segmentation, shortest word first: concatWord()
+    SEARCH_MIN_MAX,     // the fewest and the most subwords: wordPartsRange()
+    SEARCH_COUNT        // the number of segmentations: wordSplitCount()
+};
+
+// how SEARCH_FIRST segments a word
+enum SegmentAlgorithm {
+    SEGMENT_DP,         // concatWord()
+    SEGMENT_RECURSIVE,  // concatWordRecursive()
+    SEGMENT_AC          // acConcatWord(), the fewest subwords
+};
+
+// results of the search, by word
+typedef struct SearchResults {
+    vector<int> parts;          // subword count (the fewest with SEARCH_MIN_MAX), 0: not found,
+                                // CONCAT_TIMED_OUT: out of budget
+    vector<int> maxParts;       // SEARCH_MIN_MAX: the most subwords
+    vector<uint64_t> ways;      // SEARCH_COUNT: the number of segmentations, parts stays 0
+    bool explain;               // record the subword ends
+    int minParts;               // explain: keep the ends of the words with at least these parts
+    vector<int> ends;           // explain: subword ends of the words kept, in word order,
+                                // the fewest then the most with SEARCH_MIN_MAX
+    size_t endsAt;              // explain: ends of the next such word, see resultEnds()
+    vector< vector<int> > chunkEnds;    // explain: the ends by chunk during the search
+}searchResults;
+
+/**
+ * make room for the results of words
+ * Only the words with minParts subwords or more keep their subword ends:
+ * 2 for the compounds of a word list, 1 for the queries, which print a
+ * word of the list as itself. Each thread finds the ends in its own
+ * scratch and collects those of a chunk in a buffer it reuses; the chunk
+ * gets one copy of them when it is done, and the chunks are joined in
+ * order after the search.
+ */
+void resultsInit(searchResults *res, const vector<wordref> &words, int mode, bool explain, int minParts)
+{
+    res->parts.assign(words.size(), 0);
+    res->maxParts.assign(mode == SEARCH_MIN_MAX ? words.size() : 0, 0);
+    res->ways.assign(mode == SEARCH_COUNT ? words.size() : 0, 0);
+    res->explain = explain;
+    res->minParts = minParts;
+    res->ends.clear();
+    res->endsAt = 0;
+    res->chunkEnds.assign(explain ? (words.size() + SEARCH_CHUNK - 1) / SEARCH_CHUNK : 0, vector<int>());
+}
+
+// join the ends of the chunks in word order
+static void resultsJoin(searchResults *res)
+{
+    size_t total = 0;
+    for (size_t c = 0; c < res->chunkEnds.size(); c++)
+        total += res->chunkEnds[c].size();
+    res->ends.reserve(total);
+    for (size_t c = 0; c < res->chunkEnds.size(); c++) {
+        res->ends.insert(res->ends.end(), res->chunkEnds[c].begin(), res->chunkEnds[c].end());
+        vector<int>().swap(res->chunkEnds[c]);
+    }
+}
+
+// whether the subword ends of word i are kept
+static inline bool resultKeepsEnds(const searchResults *res, size_t i)
+{
+    return res->explain && res->parts[i] >= res->minParts;
+}
+
+/**
+ * the subword ends of word i with explain, NULL when it has none; to be
+ * called for every word in order, as the ends are kept in that order.
+ * maxEnds gets the ends of the most subwords with SEARCH_MIN_MAX
+ */
+static const int* resultEnds(searchResults *res, size_t i, const int **maxEnds)
+{
+    if (!resultKeepsEnds(res, i))
+        return NULL;
+    const int *ends = &res->ends[res->endsAt];
+    res->endsAt += res->parts[i];
+    if (!res->maxParts.empty()) {
+        *maxEnds = &res->ends[res->endsAt];
+        res->endsAt += res->maxParts[i];
+    }
+    return ends;
+}
+
+// whether word i is a compound
+static inline bool resultFound(const searchResults *res, size_t i)
+{
+    return res->ways.empty() ? res->parts[i] > 1 : res->ways[i] > 0;
+}
+
+template <class T>
+struct SearchShared {
+    T *dict;
+    int mode;                               // SearchMode
+    int algorithm;                          // SegmentAlgorithm
+    int64_t budget;                         // steps per word, 0: no budget
+    const vector<wordref> *words;           // longest first
+    searchResults *res;
+    size_t next;                            // first word of the next chunk
+    size_t limit;                           // stop after this many compounds, 0: search all
+    size_t found;                           // compounds found so far, with a limit
+};
+
+template <class T>
+struct SearchWorker {
+    SearchShared<T> *shared;
+    suffixCache *cache;                     // per thread, NULL when off
+    double cpu;                             // CPU time of the thread
+    vector<int> scratch;                    // explain: subword ends of the current word
+    vector<int> ends;                       // explain: subword ends kept in the current chunk
+};
+
+template <class T>
+void* searchWorker(void *arg)
+{
+    SearchWorker<T> *worker = (SearchWorker<T> *)arg;
+    SearchShared<T> *shared = worker->shared;
+    size_t cnt = shared->words->size();
+    double cpuStart = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+    for (;;) {
+        // chunks are taken in order, so the chunks taken so far are a
+        // prefix of the words, and it holds the first limit compounds
+        if (shared->limit > 0 && __atomic_load_n(&shared->found, __ATOMIC_RELAXED) >= shared->limit)
+            break;
+        size_t first = __atomic_fetch_add(&shared->next, SEARCH_CHUNK, __ATOMIC_RELAXED);
+        if (first >= cnt)
+            break;
+        size_t last = min(first + SEARCH_CHUNK, cnt);
+        searchResults *res = shared->res;
+        bool explain = res->explain;
+        vector<int> &ends = worker->ends;
+        ends.clear();
+        for (size_t i = first; i < last; i++) {
+            const wordref &word = (*shared->words)[i];
+            int *breaks = NULL;
+            if (explain) {
+                if (worker->scratch.size() < 2 * (size_t)word.len)
+                    worker->scratch.resize(2 * word.len);
+                breaks = &worker->scratch[0];
+            }
+            if (shared->mode == SEARCH_MIN_MAX) {
+                int *maxBreaks = explain ? breaks + word.len : NULL;
+                wordPartsRange(shared->dict, word.str, 0, word.len-1, res->parts[i], res->maxParts[i], breaks, maxBreaks);
+                if (resultKeepsEnds(res, i)) {
+                    ends.insert(ends.end(), breaks, breaks + res->parts[i]);
+                    ends.insert(ends.end(), maxBreaks, maxBreaks + res->maxParts[i]);
+                }
+                continue;
+            }
+            if (shared->mode == SEARCH_COUNT) {
+                res->ways[i] = wordSplitCount(shared->dict, word.str, 0, word.len-1);
+                continue;
+            }
+            bool found = false;
+            int64_t steps = shared->budget;
+            int64_t *budget = steps > 0 ? &steps : NULL;
+            int cntConcat;
+            if (shared->algorithm == SEGMENT_RECURSIVE)
+                cntConcat = concatWordRecursive(shared->dict, word.str, 0, word.len-1, found, budget);
+            else if (shared->algorithm == SEGMENT_AC)
+                cntConcat = acConcatWord(shared->dict, word.str, 0, word.len-1, found, breaks);
+            else
+                cntConcat = concatWord(shared->dict, word.str, 0, word.len-1, found, worker->cache, budget, breaks);
+            res->parts[i] = found || cntConcat == CONCAT_TIMED_OUT ? cntConcat : 0;
+            if (resultKeepsEnds(res, i))
+                ends.insert(ends.end(), breaks, breaks + res->parts[i]);
+        }
+        if (explain)
+            res->chunkEnds[first / SEARCH_CHUNK].assign(ends.begin(), ends.end());
+        if (shared->limit > 0) {
+            size_t compounds = 0;
+            for (size_t i = first; i < last; i++)
+                compounds += resultFound(res, i);
+            __atomic_fetch_add(&shared->found, compounds, __ATOMIC_RELAXED);
+        }
+    }
+    worker->cpu = cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+    return NULL;
+}
+
+/**
+ * search every word on threads, the results of words[i] go to slot i of
+ * res, made by resultsInit()
+ * mode: SearchMode; algorithm (SegmentAlgorithm) and budget only apply
+ * to SEARCH_FIRST, the budget not to SEGMENT_AC
+ * cache: suffix cache of the first thread, the others use their own
+ * and add their counters to it
+ * cpu: the CPU time of each thread is added to its entry, so calls for
+ * several batches sum up per thread
+ * limit: stop once the words searched hold this many compounds, 0: no limit
+ * returns how many words were searched, a prefix of words
+ */
+template <class T>
+size_t searchWords(T *dict, int mode, int algorithm, suffixCache *cache, int threads, int64_t budget, const vector<wordref> &words, searchResults *res, vector<double> *cpu, size_t limit = 0)
+{
+    SearchShared<T> shared = {dict, mode, algorithm, budget, &words, res, 0, limit, 0};
+    vector< SearchWorker<T> > worker(threads);
+    vector<suffixCache> caches(threads);
+    vector<pthread_t> tid(threads);
+    for (int i = 0; i < threads; i++) {
+        worker[i].shared = &shared;
+        worker[i].cache = cache;
+        if (cache != NULL && i > 0) {
+            cacheInit(&caches[i]);
+            worker[i].cache = &caches[i];
+        }
+    }
+    // the calling thread is worker 0; when a thread cannot be started, the
+    // ones running take its chunks from the shared cursor
+    int started = 1;
+    while (started < threads && pthread_create(&tid[started], NULL, searchWorker<T>, &worker[started]) == 0)
+        started++;
+    searchWorker<T>(&worker[0]);
+    for (int i = 1; i < threads; i++) {
+        if (i < started)
+            pthread_join(tid[i], NULL);
+        if (cache != NULL) {
+            cache->lookups += caches[i].lookups;
+            cache->hits += caches[i].hits;
+            cache->used += caches[i].used;
+            cacheDestroy(&caches[i]);
+        }
+    }
+    if (cpu->size() < (size_t)threads)
+        cpu->resize(threads, 0);
+    for (int i = 0; i < threads; i++)
+        (*cpu)[i] += worker[i].cpu;
+    if (res->explain)
+        resultsJoin(res);
+    return min(shared.next, words.size());
+}
+
+/**
+ * append the results of word i after the word, tab separated:
+ * SEARCH_FIRST the count (with count), SEARCH_MIN_MAX the fewest and the
+ * most, SEARCH_COUNT the number of segmentations; then with explain the
+ * subwords of each, "rat|cat|dog", ends and maxEnds from resultEnds()
+ */
+void outResults(outBuffer *out, const wordref &word, const searchResults *res, size_t i, int mode, bool count,
+                const int *ends, const int *maxEnds)
+{
+    if (mode == SEARCH_MIN_MAX) {
+        outWrite(out, "\t", 1);
+        outNumber(out, res->parts[i]);
+        outWrite(out, "\t", 1);
+        outNumber(out, res->maxParts[i]);
+    } else if (mode == SEARCH_COUNT) {
+        outWrite(out, "\t", 1);
+        outNumber(out, res->ways[i]);
+    } else if (count) {
+        outWrite(out, "\t", 1);
+        outNumber(out, res->parts[i]);
+    }
+    if (ends != NULL) {
+        outSubwords(out, word, ends, res->parts[i]);
+        if (mode == SEARCH_MIN_MAX)
+            outSubwords(out, word, maxEnds, res->maxParts[i]);
+    }
+}
+
+/**
+ * search the compound words, longest first, on threads
+ * writes every found word to the output file
+ * cache: suffix cache of the first thread, the others use their own
+ * and add their counters to it
+ * budget: Trie steps allowed per word, 0: no limit; words out of budget
+ * are reported as timed out on stderr and left out of the output
+ * top: find only the top longest compounds, 0: all of them. The words
+ * are searched longest first, so the search stops as soon as the words
+ * searched hold top compounds: no shorter word can beat them.
+ * mode: SearchMode, SEARCH_MIN_MAX writes the fewest and the most
+ * subwords after each word, "ratcatdog\t2\t3", SEARCH_COUNT the number of
+ * segmentations, "ratcatdog\t2"
+ * explain: write the subwords after each word, "ratcatdog\trat|cat|dog"
+ * timer: gets the sort, search and output phases
+ * returns the number of found words
+ */
+template <class T>
+int searchCompounds(T *dict, int mode, int algorithm, suffixCache *cache, int threads, int64_t budget, size_t top, bool explain, wordStore *store, outBuffer *foundWordsFile, phaseTimer *timer)
+{
+    phaseBegin(timer, PHASE_SORT);
+    int foundWords = 0;
+
+    // first begin with the longest length
+    storeSortByLength(store);
+    const vector<wordref> &words = store->word;
+
+    phaseEnd(timer);
+
+    phaseBegin(timer, PHASE_SEARCH);
+    searchResults res;
+    resultsInit(&res, words, mode, explain, 2);
+    size_t searched = searchWords(dict, mode, algorithm, cache, threads, budget, words, &res, &timer->searchCpu, top);
+    const vector<int> &parts = res.parts;
+    phaseEnd(timer);
+
+    phaseBegin(timer, PHASE_OUTPUT);
+
+    int timedOut = 0;
+    for (size_t i = 0; i < searched && (top == 0 || (size_t)foundWords < top); i++) {
+        if (parts[i] == CONCAT_TIMED_OUT) {
+            cerr << "timed out: " << words[i].str << endl;
+            timedOut++;
+        }
+        const int *maxEnds = NULL;
+        const int *ends = resultEnds(&res, i, &maxEnds);
+        // output this
+        if (resultFound(&res, i)) { 
+            const char *word = words[i].str;
+            if(foundWords==0)cout << "The longest output: " << word << endl;
+            else if(foundWords==1)cout << "The second longest longest output: " << word << endl;
+            foundWords++;
+            outWordName(foundWordsFile, words[i]);
+            outResults(foundWordsFile, words[i], &res, i, mode, false, ends, maxEnds);
+            outWrite(foundWordsFile, "\n", 1);
+        }
+    }
+    if (budget > 0)
+        cout << "Timed out words: " << timedOut << " (budget " << budget << " steps)" << endl;
+    if (top > 0)
+        cout << "Top " << top << ": searched " << searched << " of " << words.size() << " words" << endl;
+    phaseEnd(timer);
+    return foundWords;
+}
+
+/**
+ * Streaming queries
+ * The dictionary is built once, then candidates are read from a file
+ * descriptor in batches of QUERY_BATCH_SIZE, split in place like the word
+ * file and searched on the threads a batch at a time. Every candidate is
+ * answered in input order with one line, the candidate, a tab and its
+ * count of subwords: 0 when it is not made of dictionary words, 1 for a
+ * dictionary word that does not split, 2 or more for a compound, -1 when
+ * it ran out of the step budget. With SEARCH_MIN_MAX the fewest and the
+ * most subwords of a split into two or more words instead, 0 and 0 for
+ * none, with SEARCH_COUNT the number of segmentations into two or more.
+ * With explain, the subwords follow, "ratcatdog\t3\trat|cat|dog".
+ * The candidates are untrusted: an empty line, or one with anything but
+ * 'a'-'z' in it, never reaches the Trie and is answered 0.
+ */
+
+#define QUERY_BATCH_SIZE    (1 << 20)
+
+typedef struct QueryStats {
+    size_t queries;
+    size_t compounds;
+    size_t bytes;
+    double seconds;
+}queryStats;
+
+template <class T>
+bool streamQueries(T *dict, int mode, int algorithm, suffixCache *cache, int threads, int64_t budget, bool explain, int fd, outBuffer *out, phaseTimer *timer, queryStats *stats)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    stats->queries = 0;
+    stats->compounds = 0;
+    stats->bytes = 0;
+    vector<char> buf(QUERY_BATCH_SIZE + 1);
+    size_t have = 0;
+    vector<wordref> lines;
+    vector<wordref> words;              // the valid lines, searched
+    vector<int> slot;                   // line i: its word, -1 when invalid
+    searchResults res;
+    bool eof = false;
+    while (!eof) {
+        ssize_t n = read(fd, &buf[have], buf.size() - 1 - have);
+        if (n < 0)
+            return false;
+        eof = n == 0;
+        have += n;
+        stats->bytes += n;
+
+        // search the complete lines, all of them at the end
+        size_t cut = have;
+        if (!eof) {
+            while (cut > 0 && buf[cut - 1] != '\n')
+                cut--;
+            if (cut == 0) {
+                // a line longer than the buffer
+                if (have == buf.size() - 1)
+                    buf.resize(buf.size() * 2);
+                continue;
+            }
+        }
+        char rest = buf[cut];
+        buf[cut] = '\0';
+        lines.clear();
+        words.clear();
+        slot.clear();
+        splitLines(&buf[0], cut, [&](const char *str, int len) {
+            wordref line = {str, len};
+            lines.push_back(line);
+            slot.push_back(wordValid(str, len) ? (int)words.size() : -1);
+            if (slot.back() >= 0)
+                words.push_back(line);
+        }, true);
+        resultsInit(&res, words, mode, explain, 1);
+        // the cached suffixes point into the last batch
+        if (cache != NULL)
+            cacheClear(cache);
+        searchWords(dict, mode, algorithm, cache, threads, budget, words, &res, &timer->searchCpu);
+        for (size_t l = 0; l < lines.size(); l++) {
+            outWrite(out, lines[l].str, lines[l].len);
+            int i = slot[l];
+            if (i < 0) {
+                if (mode == SEARCH_MIN_MAX)
+                    outWrite(out, "\t0\t0\n", 5);
+                else
+                    outWrite(out, "\t0\n", 3);
+                continue;
+            }
+            if (res.parts[i] == CONCAT_TIMED_OUT) {
+                outWrite(out, "\t-1\n", 4);
+                continue;
+            }
+            const int *maxEnds = NULL;
+            const int *ends = resultEnds(&res, i, &maxEnds);
+            outResults(out, words[i], &res, i, mode, true, ends, maxEnds);
+            outWrite(out, "\n", 1);
+            stats->compounds += resultFound(&res, i);
+        }
+        stats->queries += lines.size();
+        buf[cut] = rest;
+        memmove(&buf[0], &buf[cut], have - cut);
+        have -= cut;
+    }
+    chrono::duration<double> wall = chrono::steady_clock::now() - start;
+    stats->seconds = wall.count();
+    return true;
+}
+
+/**
+ * Corpus scan
+ * Every occurrence of a dictionary word in a text file, found in one
+ * Aho-Corasick pass over the mapped file, see acScan(). Each match is
+ * written as one line, the byte offset of its first letter, a tab and the
+ * matched text; words inside words are matches too, "concatenate" holds
+ * "cat" and "ate".
+ */
+
+typedef struct ScanStats {
+    size_t bytes;
+    size_t matches;
+    double seconds;
+}scanStats;
+
+// scan a text file with the linked Trie, returns false when it cannot be read
+bool scanCorpus(const trie *root, const char *filename, outBuffer *out, scanStats *stats)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    mappedFile text;
+    if (!mapFile(filename, &text))
+        return false;
+    stats->bytes = text.size;
+    stats->matches = acScan(root, text.data, text.size, [&](size_t end, int len) {
+        outNumber(out, end + 1 - len);
+        outWrite(out, "\t", 1);
+        outWrite(out, text.data + end + 1 - len, len);
+        outWrite(out, "\n", 1);
+    });
+    unmapFile(&text);
+    chrono::duration<double> wall = chrono::steady_clock::now() - start;
+    stats->seconds = wall.count();
+    return true;
+}
+
+// bench.cpp includes this file for its kernels, with WORDS_NO_MAIN defined
+#ifndef WORDS_NO_MAIN
+int main(int argc, const char * argv[])
+{
+    // default file name with words (input file)
+    const char *filename = NULL;
+    TrieLayout layout = LAYOUT_POINTER;
+    int algorithm = SEGMENT_DP;
+    bool memo = false;
+    int threads = 1;
+    int64_t budget = 0;
+    bool positions = false;
+    bool query = false;
+    size_t top = 0;
+    bool explain = false;
+    int mode = SEARCH_FIRST;
+    const char *metricsFileName = NULL;
+    const char *imageFileName = NULL;
+    bool verifyImage = false;
+    const char *writeImageFileName = NULL;
+    const char *scanFileName = NULL;
+
+    /**
+     * command line: output [-t pointer|compact|bitmap|double-array|dawg] [-a dp|recursive|ac] [-m] [-j N] [-b steps] [-p] [-M file.json] [-w image | -i image [-V]] [-q] [--top K] [-e] [-s first|min-max|count] [--scan corpus] [filename]
+     * -t: Trie layout used for the compound word search
+     * -a: segmentation algorithm, dynamic programming (default), the
+     *     original recursion, or one Aho-Corasick pass per word for the
+     *     fewest subwords (pointer layout, the others fall back to the
+     *     dynamic programming)
+     * -m: share solved suffixes across words (dynamic programming only)
+     * -j: number of threads for the Trie build and the compound word search
+     * -b: give up a word after this many Trie steps and report it as
+     *     timed out (default: no limit; with -a recursive RECURSIVE_BUDGET,
+     *     which is also its maximum)
+     * -p: write "offset length" of each found word in the input file
+     *     instead of the word
+     * -M: also write the phase timings as JSON
+     * -w: save the Trie as an image, with -t bitmap or -t dawg
+     * -i: search against a saved image instead of building the Trie
+     * -V: check every node of the image on load, not only the root
+     * -q: use the file as the dictionary only and answer the candidates
+     *     read from stdin, one per line, with their count of subwords on
+     *     stdout; the reports go to stderr
+     * --top: find only the K longest compounds, stop searching then
+     * -e: explain, write the subwords of each word: ratcatdog<tab>rat|cat|dog
+     * -s: what to find for each word: the first segmentation (default), or
+     *     the fewest and the most subwords, or the number of segmentations,
+     *     written after the word
+     * --scan: write every occurrence of a dictionary word in the corpus
+     *     file, "offset<tab>text" on stdout, instead of the search
+     */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "pointer") == 0) {
+                layout = LAYOUT_POINTER;
+            } else if (strcmp(name, "compact") == 0) {
+                layout = LAYOUT_COMPACT;
+            } else if (strcmp(name, "bitmap") == 0) {
+                layout = LAYOUT_BITMAP;
+            } else if (strcmp(name, "double-array") == 0) {
+                layout = LAYOUT_DOUBLE_ARRAY;
+            } else if (strcmp(name, "dawg") == 0) {
+                layout = LAYOUT_DAWG;
+            } else {
+                cerr << "unknown Trie layout: " << name << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-a") == 0 && i+1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "dp") == 0) {
+                algorithm = SEGMENT_DP;
+            } else if (strcmp(name, "recursive") == 0) {
+                algorithm = SEGMENT_RECURSIVE;
+            } else if (strcmp(name, "ac") == 0) {
+                algorithm = SEGMENT_AC;
+            } else {
+                cerr << "unknown algorithm: " << name << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            memo = true;
+        } else if (strcmp(argv[i], "-M") == 0 && i+1 < argc) {
+            metricsFileName = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i+1 < argc) {
+            budget = atoll(argv[++i]);
+            if (budget < 1) {
+                cerr << "invalid step budget: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-w") == 0 && i+1 < argc) {
+            writeImageFileName = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i+1 < argc) {
+            imageFileName = argv[++i];
+        } else if (strcmp(argv[i], "-V") == 0) {
+            verifyImage = true;
+        } else if (strcmp(argv[i], "--top") == 0 && i+1 < argc) {
+            top = strtoul(argv[++i], NULL, 10);
+            if (top < 1) {
+                cerr << "invalid top count: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-s") == 0 && i+1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "first") == 0) {
+                mode = SEARCH_FIRST;
+            } else if (strcmp(name, "min-max") == 0) {
+                mode = SEARCH_MIN_MAX;
+            } else if (strcmp(name, "count") == 0) {
+                mode = SEARCH_COUNT;
+            } else {
+                cerr << "unknown search: " << name << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--scan") == 0 && i+1 < argc) {
+            scanFileName = argv[++i];
+        } else if (strcmp(argv[i], "-e") == 0) {
+            explain = true;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            query = true;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            positions = true;
+        } else if (strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) {
+                cerr << "invalid thread count: " << argv[i] << endl;
+                return 1;
+            }
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (writeImageFileName != NULL && layout != LAYOUT_BITMAP && layout != LAYOUT_DAWG) {
+        cerr << "a Trie image needs -t bitmap or -t dawg" << endl;
+        return 1;
+    }
+    // the recursion nests once per subword, never let it run unbounded
+    if (algorithm == SEGMENT_RECURSIVE && budget == 0)
+        budget = RECURSIVE_BUDGET;
+    if (algorithm == SEGMENT_RECURSIVE && budget > RECURSIVE_BUDGET) {
+        cerr << "-a recursive takes a step budget of at most " << RECURSIVE_BUDGET << endl;
+        return 1;
+    }
+    if (explain && algorithm == SEGMENT_RECURSIVE && mode == SEARCH_FIRST) {
+        cerr << "-e needs -a dp" << endl;
+        return 1;
+    }
+    if (explain && mode == SEARCH_COUNT) {
+        cerr << "-e does not apply to -s count" << endl;
+        return 1;
+    }
+    if (writeImageFileName != NULL && imageFileName != NULL) {
+        cerr << "-w and -i cannot be used together" << endl;
+        return 1;
+    }
+    if (verifyImage && imageFileName == NULL) {
+        cerr << "-V needs -i" << endl;
+        return 1;
+    }
+    if (scanFileName != NULL && (layout != LAYOUT_POINTER || imageFileName != NULL || query)) {
+        cerr << "--scan needs the pointer Trie, without -i or -q" << endl;
+        return 1;
+    }
+
+    // stdout carries the answers, send the reports to stderr
+    if (query || scanFileName != NULL)
+        cout.rdbuf(cerr.rdbuf());
+
+    // answering from an image needs no word file
+    bool wordFile = !(query && imageFileName != NULL);
+    if (filename == NULL && wordFile) {
+        cout << "default name: wordsforproblem.txt\n";
+        filename = "wordsforproblem.txt";
+    }
+    
+    // per phase execution time
+    phaseTimer timer;
+    timerInit(&timer);
+
+    // this is the root of Trie, its nodes are allocated from the arena
+    trie *root = NULL;
+    arena pool;
+    arenaInit(&pool);
+
+    // all words, sorted by length for the search
+    wordStore store;
+    storeInit(&store);
+
+    // the words stay inside the mapped input file
+    mappedFile input = {NULL, 0, 0};
+
+    phaseBegin(&timer, PHASE_LOAD);
+    int cntWords = 0;
+    int cntSkipped = 0;
+    if (wordFile)
+        cntWords = ReadWordList(filename, &input, &store, &cntSkipped);
+    phaseEnd(&timer);
+    if (cntWords < 0) {
+        cerr << "cannot read " << filename << endl;
+        return 1;
+    }
+    if (wordFile)
+        cout << "Input words: " << cntWords << endl;
+    if (cntSkipped > 0)
+        cerr << "skipped " << cntSkipped << " words with letters other than a-z" << endl;
+
+    // move the words into the selected Trie layout
+    phaseBegin(&timer, PHASE_BUILD);
+    // the double-array and the DAWG are built from the sorted words, and an
+    // image brings its own Trie: none of them needs the pointer Trie
+    if (imageFileName == NULL && layout != LAYOUT_DOUBLE_ARRAY && layout != LAYOUT_DAWG)
+        insertWords(root, &pool, &store, threads);
+    ctrie compact;
+    btrie bitmap;
+    datrie doubleArray;
+    trieImage image;
+    image.header = NULL;
+    if (imageFileName != NULL) {
+        if (!imageMap(imageFileName, &image, verifyImage)) {
+            cerr << "cannot map Trie image " << imageFileName << endl;
+            return 1;
+        }
+        layout = (TrieLayout)image.header->layout;
+        if (!wordFile)
+            cntWords = (int)image.header->words;
+        cout << "Trie image: " << layoutName[layout] << ", " << image.header->nodes << " nodes, "
+             << image.header->words << " words" << endl;
+    } else if (layout == LAYOUT_COMPACT) {
+        create(&compact, root);
+        trieDestroy(root, &pool);
+        cout << "Trie layout: compact, " << compact.node.size() << " nodes, "
+             << (double)(compact.node.size() * sizeof(cnode)) / max(cntWords, 1) << " bytes/word" << endl;
+    } else if (layout == LAYOUT_BITMAP) {
+        create(&bitmap, root);
+        trieDestroy(root, &pool);
+        cout << "Trie layout: bitmap, " << bitmap.node.size() << " nodes, "
+             << (double)(bitmap.node.size() * sizeof(bnode)) / max(cntWords, 1) << " bytes/word" << endl;
+    } else if (layout == LAYOUT_DOUBLE_ARRAY) {
+        vector<const char*> sorted;
+        sortedWords(&store, sorted);
+        create(&doubleArray, sorted);
+        cout << "Trie layout: double-array, " << doubleArray.base.size() << " slots, "
+             << (double)(doubleArray.base.size() * 2 * sizeof(int)) / max(cntWords, 1) << " bytes/word" << endl;
+    } else if (layout == LAYOUT_DAWG) {
+        vector<const char*> sorted;
+        sortedWords(&store, sorted);
+        createDawg(&bitmap, sorted);
+        cout << "Trie layout: dawg, " << bitmap.node.size() << " nodes, "
+             << (double)(bitmap.node.size() * sizeof(bnode)) / max(cntWords, 1) << " bytes/word" << endl;
+    } else {
+        cout << "Trie layout: pointer, " << pool.nodes << " nodes, "
+             << (double)(pool.nodes * sizeof(trie)) / max(cntWords, 1) << " bytes/word" << endl;
+        if (algorithm == SEGMENT_AC || scanFileName != NULL)
+            acBuild(root);
+    }
+    if (writeImageFileName != NULL) {
+        if (!imageWrite(&bitmap, layout, cntWords, writeImageFileName)) {
+            cerr << "cannot write " << writeImageFileName << endl;
+            return 1;
+        }
+        cout << "Trie image written: " << writeImageFileName << endl;
+    }
+    phaseEnd(&timer);
+
+    // output file: result, or stdout for the query answers
+    const char* foundWordsFileName = query || scanFileName != NULL ? "-" : "output_wordsforproblem.txt";
+    outBuffer foundWordsFile;
+    if (!outOpen(&foundWordsFile, foundWordsFileName, positions ? input.data : NULL)) {
+        cerr << "cannot create " << foundWordsFileName << endl;
+        return 1;
+    }
+
+    suffixCache memoCache;
+    suffixCache *cache = NULL;
+    if (memo) {
+        cacheInit(&memoCache);
+        cache = &memoCache;
+    }
+
+    int foundWords = 0;
+    queryStats stats;
+    scanStats scan;
+    bool queryOk = true;
+    if (scanFileName != NULL) {
+        phaseBegin(&timer, PHASE_SEARCH);
+        queryOk = scanCorpus(root, scanFileName, &foundWordsFile, &scan);
+        phaseEnd(&timer);
+    } else if (query) {
+        phaseBegin(&timer, PHASE_SEARCH);
+        if (image.header != NULL) {
+            queryOk = streamQueries(&image, mode, algorithm, cache, threads, budget, explain, STDIN_FILENO, &foundWordsFile, &timer, &stats);
+        } else if (layout == LAYOUT_COMPACT) {
+            queryOk = streamQueries(&compact, mode, algorithm, cache, threads, budget, explain, STDIN_FILENO, &foundWordsFile, &timer, &stats);
+        } else if (layout == LAYOUT_BITMAP || layout == LAYOUT_DAWG) {
+            queryOk = streamQueries(&bitmap, mode, algorithm, cache, threads, budget, explain, STDIN_FILENO, &foundWordsFile, &timer, &stats);
+        } else if (layout == LAYOUT_DOUBLE_ARRAY) {
+            queryOk = streamQueries(&doubleArray, mode, algorithm, cache, threads, budget, explain, STDIN_FILENO, &foundWordsFile, &timer, &stats);
+        } else {
+            queryOk = streamQueries(root, mode, algorithm, cache, threads, budget, explain, STDIN_FILENO, &foundWordsFile, &timer, &stats);
+        }
+        phaseEnd(&timer);
+        foundWords = stats.compounds;
+    } else if (image.header != NULL) {
+        foundWords = searchCompounds(&image, mode, algorithm, cache, threads, budget, top, explain, &store, &foundWordsFile, &timer);
+    } else if (layout == LAYOUT_COMPACT) {
+        foundWords = searchCompounds(&compact, mode, algorithm, cache, threads, budget, top, explain, &store, &foundWordsFile, &timer);
+    } else if (layout == LAYOUT_BITMAP || layout == LAYOUT_DAWG) {
+        foundWords = searchCompounds(&bitmap, mode, algorithm, cache, threads, budget, top, explain, &store, &foundWordsFile, &timer);
+    } else if (layout == LAYOUT_DOUBLE_ARRAY) {
+        foundWords = searchCompounds(&doubleArray, mode, algorithm, cache, threads, budget, top, explain, &store, &foundWordsFile, &timer);
+    } else {
+        foundWords = searchCompounds(root, mode, algorithm, cache, threads, budget, top, explain, &store, &foundWordsFile, &timer);
+    }
+
+    phaseBegin(&timer, PHASE_OUTPUT);
+    bool outOk = outClose(&foundWordsFile);
+    phaseEnd(&timer);
+    if (!queryOk) {
+        cerr << "cannot read " << (scanFileName != NULL ? scanFileName : "the queries") << endl;
+        return 1;
+    }
+    if (!outOk) {
+        cerr << "cannot write " << (strcmp(foundWordsFileName, "-") == 0 ? "stdout" : foundWordsFileName) << endl;
+        return 1;
+    }
+    if (scanFileName != NULL) {
+        cout << "Scanned: " << scan.bytes << " bytes, " << scan.matches << " matches, "
+             << scan.seconds << " s, " << scan.bytes / max(scan.seconds, 1e-9) / 1e6 << " MB/s" << endl;
+    }
+    if (query) {
+        cout << "Queries: " << stats.queries << ", " << stats.compounds << " compound, "
+             << stats.seconds << " s, " << stats.queries / max(stats.seconds, 1e-9) << " queries/s, "
+             << stats.bytes / max(stats.seconds, 1e-9) / 1e6 << " MB/s" << endl;
+    }
+
+    /**
+     * The output will show following things:
+     * (1) Total number of words in the input file
+     * (2) The longest output, The second longest output:
+     * (3) Total words found
+     * (4) And total execution time of the search (wall time), followed by
+     *     the time of every phase
+     */
+
+    cout << "Seconds to execute: " << timer.wall[PHASE_SORT] + timer.wall[PHASE_SEARCH] + timer.wall[PHASE_OUTPUT] << endl; 
+    cout << "Total Found words: " << foundWords << endl;
+    if (cache != NULL) {
+        cout << "Suffix cache: " << cache->lookups << " lookups, " << cache->hits << " hits ("
+             << (cache->lookups ? 100.0 * cache->hits / cache->lookups : 0.0) << "%), "
+             << cache->used << " suffixes" << endl;
+        cacheDestroy(cache);
+    }
+
+    // deallocate memory block
+    phaseBegin(&timer, PHASE_TEARDOWN);
+    size_t arenaSlabs = pool.slabs;
+    trieDestroy(root, &pool);
+    trieDestroy(&compact);
+    trieDestroy(&bitmap);
+    trieDestroy(&doubleArray);
+    imageUnmap(&image);
+    vector<wordref>().swap(store.word);
+    unmapFile(&input);
+    phaseEnd(&timer);
+
+    timerReport(&timer, query || scanFileName != NULL ? stderr : stdout);
+    if (metricsFileName != NULL &&
+        !timerWriteJson(&timer, metricsFileName, wordFile ? filename : imageFileName, layoutName[layout], threads, cntWords, foundWords, arenaSlabs)) {
+        cerr << "cannot write " << metricsFileName << endl;
+        return 1;
+    }
+    
+    return 0;
+}
+#endif // WORDS_NO_MAIN
@@ -1,3 +1,5 @@
 #!/bin/sh
-gcc -xc++ -lstdc++ -shared-libgcc words.c -o output
+gcc -xc++ -O2 -pthread words.c -o output -lstdc++ -shared-libgcc
 ./output wordsforproblem.txt
+# benchmarks: gcc -xc++ -O2 -pthread bench.cpp -o bench -lstdc++ -lm -shared-libgcc && ./bench
+# scaling inputs: gcc -xc++ -O2 gendict.cpp -o gendict -lstdc++ -lm && ./gendict -n 10M -o words10M.txt